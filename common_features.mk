@@ -134,12 +134,15 @@ ifeq ($(strip $(RGBLIGHT_ENABLE)), yes)
     RGB_KEYCODES_ENABLE := yes
     ifeq ($(strip $(RGBLIGHT_CUSTOM_DRIVER)), yes)
         OPT_DEFS += -DRGBLIGHT_CUSTOM_DRIVER
+    else ifeq ($(strip $(RGBLIGHT_DRIVER)), APA102)
+        OPT_DEFS += -DRGBLIGHT_DRIVER_APA102
+        APA102_DRIVER_REQUIRED := yes
     else
         WS2812_DRIVER_REQUIRED := yes
     endif
 endif
 
-VALID_MATRIX_TYPES := yes IS31FL3731 IS31FL3733 IS31FL3737 WS2812 custom
+VALID_MATRIX_TYPES := yes IS31FL3731 IS31FL3733 IS31FL3737 WS2812 APA102 custom
 
 LED_MATRIX_ENABLE ?= no
 ifneq ($(strip $(LED_MATRIX_ENABLE)), no)
@@ -182,21 +185,21 @@ endif
 ifeq ($(strip $(RGB_MATRIX_ENABLE)), IS31FL3731)
     OPT_DEFS += -DIS31FL3731 -DSTM32_I2C -DHAL_USE_I2C=TRUE
     COMMON_VPATH += $(DRIVER_PATH)/issi
-    SRC += is31fl3731.c
+    SRC += is31fl3731.c issi_flush.c
     QUANTUM_LIB_SRC += i2c_master.c
 endif
 
 ifeq ($(strip $(RGB_MATRIX_ENABLE)), IS31FL3733)
     OPT_DEFS += -DIS31FL3733 -DSTM32_I2C -DHAL_USE_I2C=TRUE
     COMMON_VPATH += $(DRIVER_PATH)/issi
-    SRC += is31fl3733.c
+    SRC += is31fl3733.c issi_flush.c
     QUANTUM_LIB_SRC += i2c_master.c
 endif
 
 ifeq ($(strip $(RGB_MATRIX_ENABLE)), IS31FL3737)
     OPT_DEFS += -DIS31FL3737 -DSTM32_I2C -DHAL_USE_I2C=TRUE
     COMMON_VPATH += $(DRIVER_PATH)/issi
-    SRC += is31fl3737.c
+    SRC += is31fl3737.c issi_flush.c
     QUANTUM_LIB_SRC += i2c_master.c
 endif
 
@@ -205,6 +208,11 @@ ifeq ($(strip $(RGB_MATRIX_ENABLE)), WS2812)
     WS2812_DRIVER_REQUIRED := yes
 endif
 
+ifeq ($(strip $(RGB_MATRIX_ENABLE)), APA102)
+    OPT_DEFS += -DAPA102
+    APA102_DRIVER_REQUIRED := yes
+endif
+
 ifeq ($(strip $(RGB_MATRIX_CUSTOM_KB)), yes)
     OPT_DEFS += -DRGB_MATRIX_CUSTOM_KB
 endif
@@ -213,6 +221,17 @@ ifeq ($(strip $(RGB_MATRIX_CUSTOM_USER)), yes)
     OPT_DEFS += -DRGB_MATRIX_CUSTOM_USER
 endif
 
+ifeq ($(strip $(LED_POWER_LIMIT_ENABLE)), yes)
+    LED_CORRECTION_ENABLE = yes
+    OPT_DEFS += -DLED_POWER_LIMIT_ENABLE
+    SRC += $(QUANTUM_DIR)/led_power.c
+endif
+
+ifeq ($(strip $(LED_CORRECTION_ENABLE)), yes)
+    OPT_DEFS += -DLED_CORRECTION_ENABLE
+    SRC += $(QUANTUM_DIR)/led_correction.c
+endif
+
 ifeq ($(strip $(RGB_KEYCODES_ENABLE)), yes)
     SRC += $(QUANTUM_DIR)/process_keycode/process_rgb.c
 endif
@@ -299,6 +318,10 @@ ifeq ($(strip $(WS2812_DRIVER_REQUIRED)), yes)
     endif
 endif
 
+ifeq ($(strip $(APA102_DRIVER_REQUIRED)), yes)
+    SRC += apa102.c
+endif
+
 ifeq ($(strip $(VISUALIZER_ENABLE)), yes)
     CIE1931_CURVE := yes
 endif
@@ -390,10 +413,19 @@ ifeq ($(strip $(SPLIT_KEYBOARD)), yes)
     OPT_DEFS += -DSPLIT_KEYBOARD
 
     # Include files used by all split keyboards
-    QUANTUM_SRC += $(QUANTUM_DIR)/split_common/split_util.c
+    QUANTUM_SRC += $(QUANTUM_DIR)/split_common/split_util.c \
+                   $(QUANTUM_DIR)/split_common/matrix_pack.c \
+                   $(QUANTUM_DIR)/split_common/split_frame.c
 
     # Determine which (if any) transport files are required
-    ifneq ($(strip $(SPLIT_TRANSPORT)), custom)
+    ifeq ($(strip $(SPLIT_TRANSPORT)), nodes)
+        OPT_DEFS += -DSPLIT_TRANSPORT_NODES
+        QUANTUM_SRC += $(QUANTUM_DIR)/split_common/transport_nodes.c
+        ifeq ($(PLATFORM),AVR)
+            QUANTUM_LIB_SRC += i2c_master.c \
+                               i2c_slave.c
+        endif
+    else ifneq ($(strip $(SPLIT_TRANSPORT)), custom)
         QUANTUM_SRC += $(QUANTUM_DIR)/split_common/transport.c
         # Functions added via QUANTUM_LIB_SRC are only included in the final binary if they're called.
         # Unused functions are pruned away, which is why we can add multiple drivers here without bloat.
@@ -409,6 +441,10 @@ ifeq ($(strip $(SPLIT_KEYBOARD)), yes)
             QUANTUM_LIB_SRC += serial_$(strip $(SERIAL_DRIVER)).c
         endif
     endif
+    ifeq ($(strip $(SPLIT_LINK_STATS_ENABLE)), yes)
+        OPT_DEFS += -DSPLIT_LINK_STATS_ENABLE
+        QUANTUM_SRC += $(QUANTUM_DIR)/split_common/split_stats.c
+    endif
     COMMON_VPATH += $(QUANTUM_PATH)/split_common
 endif
 
@@ -435,10 +471,22 @@ ifeq ($(strip $(HD44780_ENABLE)), yes)
     OPT_DEFS += -DHD44780_ENABLE
 endif
 
+VALID_OLED_TRANSPORT_TYPES := i2c spi
+
+OLED_TRANSPORT ?= i2c
+
 ifeq ($(strip $(OLED_DRIVER_ENABLE)), yes)
+    ifeq ($(filter $(OLED_TRANSPORT),$(VALID_OLED_TRANSPORT_TYPES)),)
+        $(error OLED_TRANSPORT="$(OLED_TRANSPORT)" is not a valid OLED transport)
+    endif
+
     OPT_DEFS += -DOLED_DRIVER_ENABLE
     COMMON_VPATH += $(DRIVER_PATH)/oled
-    QUANTUM_LIB_SRC += i2c_master.c
+    ifeq ($(strip $(OLED_TRANSPORT)), spi)
+        OPT_DEFS += -DOLED_TRANSPORT_SPI
+    else
+        QUANTUM_LIB_SRC += i2c_master.c
+    endif
     SRC += oled_driver.c
 endif
 
@@ -1,7 +1,7 @@
 /*
- * APA102 lib V1.0a
+ * APA102 lib V2.0
  *
- * Controls APA102 RGB-LEDs
+ * Controls APA102 and SK9822 RGB-LEDs over the hardware SPI
  * Author: Mikkel (Duckle29 on github)
  *
  * Dec 22th, 2017  v1.0a Initial Version
@@ -21,40 +21,106 @@
  */
 
 #include "apa102.h"
-#include <avr/interrupt.h>
 #include <avr/io.h>
-#include <util/delay.h>
-#include "debug.h"
+#include <avr/pgmspace.h>
+#include "quantum.h"
 
-// Setleds for standard RGB
-void inline apa102_setleds(LED_TYPE *ledarray, uint16_t leds) { apa102_setleds_pin(ledarray, leds, _BV(RGB_DI_PIN & 0xF), _BV(RGB_CLK_PIN & 0xF)); }
+#if defined(__AVR_AT90USB162__) || defined(__AVR_ATmega16U2__) || defined(__AVR_ATmega32U2__) || defined(__AVR_ATmega16U4__) || defined(__AVR_ATmega32U4__) || defined(__AVR_AT90USB646__) || defined(__AVR_AT90USB647__) || defined(__AVR_AT90USB1286__) || defined(__AVR_AT90USB1287__)
+#    define APA102_SPI_SS B0
+#    define APA102_SPI_SCK B1
+#    define APA102_SPI_MOSI B2
+#elif defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328__)
+#    define APA102_SPI_SS B2
+#    define APA102_SPI_MOSI B3
+#    define APA102_SPI_SCK B5
+#elif defined(__AVR_ATmega32A__)
+#    define APA102_SPI_SS B4
+#    define APA102_SPI_MOSI B5
+#    define APA102_SPI_SCK B7
+#else
+#    error "APA102 hardware SPI is not supported on this MCU"
+#endif
 
-void static inline apa102_setleds_pin(LED_TYPE *ledarray, uint16_t leds, uint8_t pinmask_DI, uint8_t pinmask_CLK) {
-    pinMode(RGB_DI_PIN, PinDirectionOutput);
-    pinMode(RGB_CLK_PIN, PinDirectionOutput);
+// SPI clock divisor, 2 gives 8 MHz on a 16 MHz MCU
+#ifndef APA102_SPI_DIVISOR
+#    define APA102_SPI_DIVISOR 2
+#endif
 
-    apa102_send_array((uint8_t *)ledarray, leds)
+#if APA102_SPI_DIVISOR == 2
+#    define APA102_SPCR 0
+#    define APA102_SPSR _BV(SPI2X)
+#elif APA102_SPI_DIVISOR == 4
+#    define APA102_SPCR 0
+#    define APA102_SPSR 0
+#elif APA102_SPI_DIVISOR == 8
+#    define APA102_SPCR _BV(SPR0)
+#    define APA102_SPSR _BV(SPI2X)
+#elif APA102_SPI_DIVISOR == 16
+#    define APA102_SPCR _BV(SPR0)
+#    define APA102_SPSR 0
+#elif APA102_SPI_DIVISOR == 32
+#    define APA102_SPCR _BV(SPR1)
+#    define APA102_SPSR _BV(SPI2X)
+#elif APA102_SPI_DIVISOR == 64
+#    define APA102_SPCR _BV(SPR1)
+#    define APA102_SPSR 0
+#else
+#    error "APA102_SPI_DIVISOR must be one of 2, 4, 8, 16, 32 or 64"
+#endif
+
+// Highest global brightness used, out of 31
+#ifndef APA102_BRIGHTNESS
+#    define APA102_BRIGHTNESS 31
+#endif
+
+// Channel multiplier for each global brightness, in 1/256. A color is sent
+// with the lowest global brightness that can show it, and its channels
+// scaled up to match, so dim colors keep all 8 bits of resolution.
+#define APA102_CHANNEL_SCALE(level) ((APA102_BRIGHTNESS * 256UL + (level) / 2) / (level))
+#define APA102_CHANNEL_SCALES(l) APA102_CHANNEL_SCALE(l), APA102_CHANNEL_SCALE(l + 1), APA102_CHANNEL_SCALE(l + 2), APA102_CHANNEL_SCALE(l + 3)
+
+static const uint16_t PROGMEM channel_scale[32] = {
+    0, APA102_CHANNEL_SCALES(1), APA102_CHANNEL_SCALES(5), APA102_CHANNEL_SCALES(9), APA102_CHANNEL_SCALES(13), APA102_CHANNEL_SCALES(17), APA102_CHANNEL_SCALES(21), APA102_CHANNEL_SCALES(25), APA102_CHANNEL_SCALE(29), APA102_CHANNEL_SCALE(30), APA102_CHANNEL_SCALE(31),
+};
+
+static inline uint8_t apa102_scale_channel(uint8_t value, uint16_t scale) {
+    uint16_t scaled = ((uint32_t)value * scale + 128) >> 8;
+    return scaled < 255 ? scaled : 255;
 }
 
-void apa102_send_array(uint8_t *data, uint16_t leds) {  // Data is struct of 3 bytes. RGB - leds is number of leds in data
-    apa102_start_frame();
-    while (leds--) {
-        apa102_send_frame(0xFF000000 | (data->b << 16) | (data->g << 8) | data->r);
-        data++;
+static inline void apa102_send_byte(uint8_t byte) {
+    SPDR = byte;
+    while (!(SPSR & _BV(SPIF))) {
     }
-    apa102_end_frame(leds);
 }
 
-void apa102_send_frame(uint32_t frame) {
-    for (uint32_t i = 0xFF; i > 0;) {
-        apa102_send_byte(frame & i);
-        i = i << 8;
-    }
+static void apa102_init(void) {
+    // SS has to stay high or be an output, or the SPI drops out of master mode
+    setPinOutput(APA102_SPI_SS);
+    setPinOutput(APA102_SPI_SCK);
+    setPinOutput(APA102_SPI_MOSI);
+
+    // master, mode 0, MSB first
+    SPCR = _BV(SPE) | _BV(MSTR) | APA102_SPCR;
+    SPSR = APA102_SPSR;
 }
 
-void apa102_start_frame() { apa102_send_frame(0); }
+static void apa102_send_led(LED_TYPE color) {
+    uint8_t max = color.r > color.g ? color.r : color.g;
+    if (color.b > max) max = color.b;
+
+    // lowest level with max * APA102_BRIGHTNESS / 255 <= level
+    uint16_t x     = max * APA102_BRIGHTNESS + 254;
+    uint8_t  level = (x + 1 + (x >> 8)) >> 8;
+    uint16_t scale = pgm_read_word(&channel_scale[level]);
 
-void apa102_end_frame(uint16_t leds) {
+    apa102_send_byte(0xE0 | level);
+    apa102_send_byte(apa102_scale_channel(color.b, scale));
+    apa102_send_byte(apa102_scale_channel(color.g, scale));
+    apa102_send_byte(apa102_scale_channel(color.r, scale));
+}
+
+static void apa102_end_frame(uint16_t leds) {
     // This function has been taken from: https://github.com/pololu/apa102-arduino/blob/master/APA102.h
     // and adapted. The code is MIT licensed. I think thats compatible?
 
@@ -87,10 +153,19 @@ void apa102_end_frame(uint16_t leds) {
     }
 }
 
-void apa102_send_byte(uint8_t byte) {
-    uint8_t i;
-    for (i = 0; i < 8; i++) {
-    digitalWrite(RGB_DI_PIN, !!(byte & (1 << (7-i)));
-    digitalWrite(RGB_CLK_PIN, PinLevelHigh);
+void apa102_setleds(LED_TYPE *ledarray, uint16_t leds) {
+    static bool s_init = false;
+    if (!s_init) {
+        apa102_init();
+        s_init = true;
     }
+
+    // start frame
+    for (uint8_t i = 0; i < 4; i++) {
+        apa102_send_byte(0);
+    }
+    for (uint16_t i = 0; i < leds; i++) {
+        apa102_send_led(ledarray[i]);
+    }
+    apa102_end_frame(leds);
 }
@@ -1,10 +1,8 @@
 /*
- * light weight WS2812 lib include
+ * APA102 lib V2.0
  *
- * Version 2.3  - Nev 29th 2015
- * Author: Tim (cpldcpu@gmail.com)
- *
- * Please do not change this file! All configuration is handled in "ws2812_config.h"
+ * Controls APA102 and SK9822 RGB-LEDs over the hardware SPI
+ * Author: Mikkel (Duckle29 on github)
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -22,24 +20,17 @@
 
 #pragma once
 
-#include <avr/io.h>
-#include <avr/interrupt.h>
-
-#include "color.h"
+#include "quantum/color.h"
 
 /* User Interface
  *
  * Input:
- *         ledarray:           An array of GRB data describing the LED colors
+ *         ledarray:           An array of RGB data describing the LED colors
  *         number_of_leds:     The number of LEDs to write
- *         pinmask (optional): Bitmask describing the output bin. e.g. _BV(PB0)
  *
  * The functions will perform the following actions:
- *         - Set the data-out pin as output
- *         - Send out the LED data
- *         - Wait 50�s to reset the LEDs
+ *         - Set up the SPI as master, the first time it is called
+ *         - Send out the LED data, dimming with the global brightness of each LED
+ *         - Send the end frame that latches the data in every LED
  */
-
 void apa102_setleds(LED_TYPE *ledarray, uint16_t number_of_leds);
-void apa102_setleds_pin(LED_TYPE *ledarray, uint16_t number_of_leds, uint8_t pinmask);
-void apa102_setleds_rgbw(LED_TYPE *ledarray, uint16_t number_of_leds);
@@ -218,6 +218,43 @@ error:
     return (status < 0) ? status : I2C_STATUS_SUCCESS;
 }
 
+i2c_status_t i2c_writeReadReg(uint8_t devaddr, uint8_t regaddr, const uint8_t* txdata, uint16_t txlength, uint8_t* rxdata, uint16_t rxlength, uint16_t timeout) {
+    i2c_status_t status = i2c_start(devaddr | 0x00, timeout);
+    if (status < 0) {
+        goto error;
+    }
+
+    status = i2c_write(regaddr, timeout);
+    for (uint16_t i = 0; i < txlength && status >= 0; i++) {
+        status = i2c_write(txdata[i], timeout);
+    }
+    if (status < 0) {
+        goto error;
+    }
+
+    // repeated start, the register pointer continues after the written data
+    status = i2c_start(devaddr | 0x01, timeout);
+
+    for (uint16_t i = 0; i < (rxlength - 1) && status >= 0; i++) {
+        status = i2c_read_ack(timeout);
+        if (status >= 0) {
+            rxdata[i] = status;
+        }
+    }
+
+    if (status >= 0) {
+        status = i2c_read_nack(timeout);
+        if (status >= 0) {
+            rxdata[(rxlength - 1)] = status;
+        }
+    }
+
+error:
+    i2c_stop();
+
+    return (status < 0) ? status : I2C_STATUS_SUCCESS;
+}
+
 void i2c_stop(void) {
     // transmit STOP condition
     TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWSTO);
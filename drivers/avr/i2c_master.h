@@ -41,6 +41,7 @@ i2c_status_t i2c_transmit(uint8_t address, const uint8_t* data, uint16_t length,
 i2c_status_t i2c_receive(uint8_t address, uint8_t* data, uint16_t length, uint16_t timeout);
 i2c_status_t i2c_writeReg(uint8_t devaddr, uint8_t regaddr, const uint8_t* data, uint16_t length, uint16_t timeout);
 i2c_status_t i2c_readReg(uint8_t devaddr, uint8_t regaddr, uint8_t* data, uint16_t length, uint16_t timeout);
+i2c_status_t i2c_writeReadReg(uint8_t devaddr, uint8_t regaddr, const uint8_t* txdata, uint16_t txlength, uint8_t* rxdata, uint16_t rxlength, uint16_t timeout);
 void         i2c_stop(void);
 
 #endif  // I2C_MASTER_H
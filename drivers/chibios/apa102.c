@@ -0,0 +1,119 @@
+#include "quantum.h"
+#include "apa102.h"
+
+#ifdef RGBW
+#    error "RGBW not supported"
+#endif
+
+// Define the spi your LEDs are plugged to here
+#ifndef APA102_SPI
+#    define APA102_SPI SPID1
+#endif
+
+#ifndef APA102_SPI_PAL_MODE
+#    define APA102_SPI_PAL_MODE 5
+#endif
+
+// SPI_CR1 baudrate bits, fpclk / 8 by default
+#ifndef APA102_SPI_BAUDRATE
+#    define APA102_SPI_BAUDRATE SPI_CR1_BR_1
+#endif
+
+#ifndef APA102_LED_COUNT
+#    ifdef RGBLED_NUM
+#        define APA102_LED_COUNT RGBLED_NUM
+#    else
+#        define APA102_LED_COUNT DRIVER_LED_TOTAL
+#    endif
+#endif
+
+// Highest global brightness used, out of 31
+#ifndef APA102_BRIGHTNESS
+#    define APA102_BRIGHTNESS 31
+#endif
+
+// Start frame, 4 bytes per LED, then the 0xFF and zeros of the end frame,
+// see drivers/avr/apa102.c for why it is this long
+#define START_SIZE 4
+#define END_SIZE (1 + 5 + APA102_LED_COUNT / 16)
+#define TX_SIZE(leds) (START_SIZE + 4 * (leds) + END_SIZE)
+
+static uint8_t   txbuf[TX_SIZE(APA102_LED_COUNT)];
+static SPIConfig spi_cfg;
+
+// Set from the SPI interrupt once the frame in txbuf has been sent
+static volatile bool tx_busy = false;
+
+static void apa102_spi_done(SPIDriver *spip) {
+    (void)spip;
+    tx_busy = false;
+}
+
+// Channel multiplier for each global brightness, in 1/256, so a color is
+// sent with the lowest global brightness that can show it at full resolution
+static uint16_t channel_scale[32];
+
+static void apa102_init(void) {
+    for (uint8_t level = 1; level < 32; level++) {
+        channel_scale[level] = (APA102_BRIGHTNESS * 256UL + level / 2) / level;
+    }
+
+#if defined(USE_GPIOV1)
+    palSetLineMode(RGB_DI_PIN, PAL_MODE_STM32_ALTERNATE_PUSHPULL);
+    palSetLineMode(RGB_CLK_PIN, PAL_MODE_STM32_ALTERNATE_PUSHPULL);
+#else
+    palSetLineMode(RGB_DI_PIN, PAL_MODE_ALTERNATE(APA102_SPI_PAL_MODE) | PAL_STM32_OTYPE_PUSHPULL | PAL_STM32_OSPEED_HIGHEST);
+    palSetLineMode(RGB_CLK_PIN, PAL_MODE_ALTERNATE(APA102_SPI_PAL_MODE) | PAL_STM32_OTYPE_PUSHPULL | PAL_STM32_OSPEED_HIGHEST);
+#endif
+
+    // mode 0, MSB first, no slave select
+    spi_cfg.end_cb = apa102_spi_done;
+    spi_cfg.cr1    = APA102_SPI_BAUDRATE;
+
+    spiAcquireBus(&APA102_SPI);
+    spiStart(&APA102_SPI, &spi_cfg);
+}
+
+static inline uint8_t apa102_scale_channel(uint8_t value, uint16_t scale) {
+    uint16_t scaled = ((uint32_t)value * scale + 128) >> 8;
+    return scaled < 255 ? scaled : 255;
+}
+
+static void apa102_encode(uint8_t *tx, LED_TYPE color) {
+    uint8_t max = color.r > color.g ? color.r : color.g;
+    if (color.b > max) max = color.b;
+
+    uint8_t  level = (max * APA102_BRIGHTNESS + 254) / 255;
+    uint16_t scale = channel_scale[level];
+    tx[0]          = 0xE0 | level;
+    tx[1]          = apa102_scale_channel(color.b, scale);
+    tx[2]          = apa102_scale_channel(color.g, scale);
+    tx[3]          = apa102_scale_channel(color.r, scale);
+}
+
+void apa102_setleds(LED_TYPE *ledarray, uint16_t leds) {
+    static bool s_init = false;
+    if (!s_init) {
+        apa102_init();
+        s_init = true;
+    }
+
+    if (leds > APA102_LED_COUNT) leds = APA102_LED_COUNT;
+
+    // A frame takes well under a millisecond, so this only waits when
+    // updates come back to back
+    while (tx_busy) {
+    }
+
+    for (uint16_t i = 0; i < leds; i++) {
+        apa102_encode(&txbuf[START_SIZE + 4 * i], ledarray[i]);
+    }
+
+    // the end frame follows the last LED sent, the start frame stays zeros
+    uint8_t *end = &txbuf[START_SIZE + 4 * leds];
+    memset(end, 0, END_SIZE);
+    end[0] = 0xFF;
+
+    tx_busy = true;
+    spiStartSend(&APA102_SPI, TX_SIZE(leds), txbuf);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "quantum/color.h"
+
+/* User Interface
+ *
+ * Input:
+ *         ledarray:           An array of RGB data describing the LED colors
+ *         number_of_leds:     The number of LEDs to write
+ *
+ * The functions will perform the following actions:
+ *         - Encode the LED data, dimming with the global brightness of each LED
+ *         - Start a DMA transfer of the frame and return without waiting for it
+ */
+void apa102_setleds(LED_TYPE *ledarray, uint16_t number_of_leds);
@@ -31,6 +31,16 @@
 
 static uint8_t i2c_address;
 
+// Serialise transfers when the bus is shared between threads, e.g. with the
+// ISSI_ASYNC_FLUSH LED thread. i2cStart() must not run during a transfer.
+#if I2C_USE_MUTUAL_EXCLUSION
+#    define i2c_acquire() i2cAcquireBus(&I2C_DRIVER)
+#    define i2c_release() i2cReleaseBus(&I2C_DRIVER)
+#else
+#    define i2c_acquire()
+#    define i2c_release()
+#endif
+
 static const I2CConfig i2cconfig = {
 #ifdef USE_I2CV1
     I2C1_OPMODE,
@@ -77,20 +87,25 @@ i2c_status_t i2c_start(uint8_t address) {
 }
 
 i2c_status_t i2c_transmit(uint8_t address, const uint8_t* data, uint16_t length, uint16_t timeout) {
+    i2c_acquire();
     i2c_address = address;
     i2cStart(&I2C_DRIVER, &i2cconfig);
     msg_t status = i2cMasterTransmitTimeout(&I2C_DRIVER, (i2c_address >> 1), data, length, 0, 0, TIME_MS2I(timeout));
+    i2c_release();
     return chibios_to_qmk(&status);
 }
 
 i2c_status_t i2c_receive(uint8_t address, uint8_t* data, uint16_t length, uint16_t timeout) {
+    i2c_acquire();
     i2c_address = address;
     i2cStart(&I2C_DRIVER, &i2cconfig);
     msg_t status = i2cMasterReceiveTimeout(&I2C_DRIVER, (i2c_address >> 1), data, length, TIME_MS2I(timeout));
+    i2c_release();
     return chibios_to_qmk(&status);
 }
 
 i2c_status_t i2c_writeReg(uint8_t devaddr, uint8_t regaddr, const uint8_t* data, uint16_t length, uint16_t timeout) {
+    i2c_acquire();
     i2c_address = devaddr;
     i2cStart(&I2C_DRIVER, &i2cconfig);
 
@@ -101,13 +116,33 @@ i2c_status_t i2c_writeReg(uint8_t devaddr, uint8_t regaddr, const uint8_t* data,
     complete_packet[0] = regaddr;
 
     msg_t status = i2cMasterTransmitTimeout(&I2C_DRIVER, (i2c_address >> 1), complete_packet, length + 1, 0, 0, TIME_MS2I(timeout));
+    i2c_release();
     return chibios_to_qmk(&status);
 }
 
 i2c_status_t i2c_readReg(uint8_t devaddr, uint8_t regaddr, uint8_t* data, uint16_t length, uint16_t timeout) {
+    i2c_acquire();
     i2c_address = devaddr;
     i2cStart(&I2C_DRIVER, &i2cconfig);
     msg_t status = i2cMasterTransmitTimeout(&I2C_DRIVER, (i2c_address >> 1), &regaddr, 1, data, length, TIME_MS2I(timeout));
+    i2c_release();
+    return chibios_to_qmk(&status);
+}
+
+i2c_status_t i2c_writeReadReg(uint8_t devaddr, uint8_t regaddr, const uint8_t* txdata, uint16_t txlength, uint8_t* rxdata, uint16_t rxlength, uint16_t timeout) {
+    i2c_acquire();
+    i2c_address = devaddr;
+    i2cStart(&I2C_DRIVER, &i2cconfig);
+
+    uint8_t complete_packet[txlength + 1];
+    for (uint16_t i = 0; i < txlength; i++) {
+        complete_packet[i + 1] = txdata[i];
+    }
+    complete_packet[0] = regaddr;
+
+    // ChibiOS issues a repeated start between the transmit and receive phases
+    msg_t status = i2cMasterTransmitTimeout(&I2C_DRIVER, (i2c_address >> 1), complete_packet, txlength + 1, rxdata, rxlength, TIME_MS2I(timeout));
+    i2c_release();
     return chibios_to_qmk(&status);
 }
 
@@ -23,6 +23,27 @@
 #ifndef WS2812_DMA_CHANNEL
 #    define WS2812_DMA_CHANNEL 2  // DMA Channel for TIMx_UP
 #endif
+#if (STM32_DMA_SUPPORTS_DMAMUX == TRUE) && !defined(WS2812_DMAMUX_ID)
+#    error "please consult your MCU's datasheet and specify in your config.h: #define WS2812_DMAMUX_ID STM32_DMAMUX1_TIM?_UP"
+#endif
+
+// Set for pins on a complementary timer output, TIMx_CHyN
+#ifdef WS2812_PWM_COMPLEMENTARY_OUTPUT
+#    define WS2812_PWM_OUTPUT_MODE PWM_COMPLEMENTARY_OUTPUT_ACTIVE_HIGH
+#else
+#    define WS2812_PWM_OUTPUT_MODE PWM_OUTPUT_ACTIVE_HIGH
+#endif
+
+// Set when WS2812_PWM_DRIVER is a 16-bit timer, to move halfwords and halve
+// the frame buffer. A halfword write to a 32-bit timer such as TIM2 lands in
+// both halves of CCR, so it must stay unset for those.
+#ifdef WS2812_PWM_TIMER_16BIT
+typedef uint16_t ws2812_duty_t;
+#    define WS2812_DMA_SIZE (STM32_DMA_CR_PSIZE_HWORD | STM32_DMA_CR_MSIZE_HWORD)
+#else
+typedef uint32_t ws2812_duty_t;
+#    define WS2812_DMA_SIZE (STM32_DMA_CR_PSIZE_WORD | STM32_DMA_CR_MSIZE_WORD)
+#endif
 
 #ifndef WS2812_PWM_TARGET_PERIOD
 //#    define WS2812_PWM_TARGET_PERIOD 800000 // Original code is 800k...?
@@ -127,7 +148,15 @@
 
 /* --- PRIVATE VARIABLES ---------------------------------------------------- */
 
-static uint32_t ws2812_frame_buffer[WS2812_BIT_N + 1]; /**< Buffer for a frame */
+/**
+ * @brief   Buffer for a frame
+ *
+ * One duty cycle per bit, sized to the timer, see WS2812_PWM_TIMER_16BIT.
+ * The DMA runs in circular mode, so a new frame is handed off by writing it here.
+ */
+static ws2812_duty_t ws2812_frame_buffer[WS2812_BIT_N + 1];
+
+static LED_TYPE ws2812_led_sent[RGBLED_NUM]; /**< Last color written for each LED */
 
 /* --- PUBLIC FUNCTIONS ----------------------------------------------------- */
 /*
@@ -157,7 +186,7 @@ void ws2812_init(void) {
         .channels =
             {
                 [0 ... 3]                = {.mode = PWM_OUTPUT_DISABLED, .callback = NULL},     // Channels default to disabled
-                [WS2812_PWM_CHANNEL - 1] = {.mode = PWM_OUTPUT_ACTIVE_HIGH, .callback = NULL},  // Turn on the channel we care about
+                [WS2812_PWM_CHANNEL - 1] = {.mode = WS2812_PWM_OUTPUT_MODE, .callback = NULL},  // Turn on the channel we care about
             },
         .cr2  = 0,
         .dier = TIM_DIER_UDE,  // DMA on update event for next period
@@ -170,8 +199,11 @@ void ws2812_init(void) {
     dmaStreamSetPeripheral(WS2812_DMA_STREAM, &(WS2812_PWM_DRIVER.tim->CCR[WS2812_PWM_CHANNEL - 1]));  // Ziel ist der An-Zeit im Cap-Comp-Register
     dmaStreamSetMemory0(WS2812_DMA_STREAM, ws2812_frame_buffer);
     dmaStreamSetTransactionSize(WS2812_DMA_STREAM, WS2812_BIT_N);
-    dmaStreamSetMode(WS2812_DMA_STREAM, STM32_DMA_CR_CHSEL(WS2812_DMA_CHANNEL) | STM32_DMA_CR_DIR_M2P | STM32_DMA_CR_PSIZE_WORD | STM32_DMA_CR_MSIZE_WORD | STM32_DMA_CR_MINC | STM32_DMA_CR_CIRC | STM32_DMA_CR_PL(3));
+    dmaStreamSetMode(WS2812_DMA_STREAM, STM32_DMA_CR_CHSEL(WS2812_DMA_CHANNEL) | STM32_DMA_CR_DIR_M2P | WS2812_DMA_SIZE | STM32_DMA_CR_MINC | STM32_DMA_CR_CIRC | STM32_DMA_CR_PL(3));
     // M2P: Memory 2 Periph; PL: Priority Level
+#if (STM32_DMA_SUPPORTS_DMAMUX == TRUE)
+    dmaSetRequestSource(WS2812_DMA_STREAM, WS2812_DMAMUX_ID);
+#endif
 
     // Start DMA
     dmaStreamEnable(WS2812_DMA_STREAM);
@@ -195,13 +227,18 @@ void ws2812_write_led(uint16_t led_number, uint8_t r, uint8_t g, uint8_t b) {
 
 // Setleds for standard RGB
 void ws2812_setleds(LED_TYPE* ledarray, uint16_t leds) {
-    static bool s_init = false;
+    static bool s_init     = false;
+    bool        encode_all = !s_init;
     if (!s_init) {
         ws2812_init();
         s_init = true;
     }
 
+    // Only changed LEDs are written, the DMA keeps streaming the rest
     for (uint16_t i = 0; i < leds; i++) {
-        ws2812_write_led(i, ledarray[i].r, ledarray[i].g, ledarray[i].b);
+        if (encode_all || memcmp(&ledarray[i], &ws2812_led_sent[i], sizeof(LED_TYPE)) != 0) {
+            ws2812_led_sent[i] = ledarray[i];
+            ws2812_write_led(i, ledarray[i].r, ledarray[i].g, ledarray[i].b);
+        }
     }
 }
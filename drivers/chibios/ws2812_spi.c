@@ -23,68 +23,130 @@
 #define RESET_SIZE 200
 #define PREAMBLE_SIZE 4
 
-static uint8_t txbuf[PREAMBLE_SIZE + DATA_SIZE + RESET_SIZE] = {0};
+#ifndef MIN
+#    define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+
+// Long strips can be split into chains on separate SPI peripherals, which
+// are sent in parallel. The LEDs are assigned to the chains in order.
+#ifdef WS2812_SPI_CHAIN_LEDS
+static SPIDriver* const chain_spi[]  = WS2812_SPI_CHAIN_DRIVERS;
+static const pin_t      chain_pin[]  = WS2812_SPI_CHAIN_PINS;
+static const uint16_t   chain_leds[] = WS2812_SPI_CHAIN_LEDS;
+#    ifdef WS2812_SPI_CHAIN_PAL_MODES
+static const uint8_t chain_pal_mode[] = WS2812_SPI_CHAIN_PAL_MODES;
+#    endif
+#else
+static SPIDriver* const chain_spi[]  = {&WS2812_SPI};
+static const pin_t      chain_pin[]  = {RGB_DI_PIN};
+static const uint16_t   chain_leds[] = {RGBLED_NUM};
+#endif
+#define NB_CHAINS (sizeof(chain_leds) / sizeof(chain_leds[0]))
+
+_Static_assert(sizeof(chain_spi) / sizeof(chain_spi[0]) == NB_CHAINS, "WS2812_SPI_CHAIN_DRIVERS needs one entry per chain");
+_Static_assert(sizeof(chain_pin) / sizeof(chain_pin[0]) == NB_CHAINS, "WS2812_SPI_CHAIN_PINS needs one entry per chain");
+
+// Each chain gets its own preamble, data and reset in the buffer
+#define CHAIN_OVERHEAD (PREAMBLE_SIZE + RESET_SIZE)
+
+static uint8_t   txbuf[NB_CHAINS * CHAIN_OVERHEAD + DATA_SIZE] = {0};
+static uint8_t*  chain_data[NB_CHAINS];
+static uint16_t  chain_size[NB_CHAINS];
+static SPIConfig chain_cfg[NB_CHAINS];
+
+// Last color sent to each LED, only changed LEDs are encoded again
+static LED_TYPE led_sent[RGBLED_NUM];
 
 /*
  * As the trick here is to use the SPI to send a huge pattern of 0 and 1 to
- * the ws2812b protocol, we use this helper function to translate bytes into
- * 0s and 1s for the LED (with the appropriate timing).
+ * the ws2812b protocol, every data bit becomes the 4 bit symbol 0b1110 or
+ * 0b1000. This table holds the two SPI bytes for each nibble of data.
  */
-static uint8_t get_protocol_eq(uint8_t data, int pos) {
-    uint8_t eq = 0;
-    if (data & (1 << (2 * (3 - pos))))
-        eq = 0b1110;
-    else
-        eq = 0b1000;
-    if (data & (2 << (2 * (3 - pos))))
-        eq += 0b11100000;
-    else
-        eq += 0b10000000;
-    return eq;
-}
+#define WS2812_SYMBOL(bit) ((bit) ? 0b1110 : 0b1000)
+#define WS2812_NIBBLE(n) \
+    { (WS2812_SYMBOL((n)&8) << 4) | WS2812_SYMBOL((n)&4), (WS2812_SYMBOL((n)&2) << 4) | WS2812_SYMBOL((n)&1) }
 
-static void set_led_color_rgb(LED_TYPE color, int pos) {
-    uint8_t* tx_start = &txbuf[PREAMBLE_SIZE];
+static const uint8_t nibble_eq[16][2] = {
+    WS2812_NIBBLE(0),  WS2812_NIBBLE(1),  WS2812_NIBBLE(2),  WS2812_NIBBLE(3),  WS2812_NIBBLE(4),  WS2812_NIBBLE(5),  WS2812_NIBBLE(6),  WS2812_NIBBLE(7),
+    WS2812_NIBBLE(8),  WS2812_NIBBLE(9),  WS2812_NIBBLE(10), WS2812_NIBBLE(11), WS2812_NIBBLE(12), WS2812_NIBBLE(13), WS2812_NIBBLE(14), WS2812_NIBBLE(15),
+};
 
-    for (int j = 0; j < 4; j++) tx_start[BYTES_FOR_LED * pos + j] = get_protocol_eq(color.g, j);
-    for (int j = 0; j < 4; j++) tx_start[BYTES_FOR_LED * pos + BYTES_FOR_LED_BYTE + j] = get_protocol_eq(color.r, j);
-    for (int j = 0; j < 4; j++) tx_start[BYTES_FOR_LED * pos + BYTES_FOR_LED_BYTE * 2 + j] = get_protocol_eq(color.b, j);
+static inline void set_led_byte(uint8_t* tx, uint8_t data) {
+    tx[0] = nibble_eq[data >> 4][0];
+    tx[1] = nibble_eq[data >> 4][1];
+    tx[2] = nibble_eq[data & 0xF][0];
+    tx[3] = nibble_eq[data & 0xF][1];
+}
+
+static void set_led_color_rgb(uint8_t* tx, LED_TYPE color) {
+    set_led_byte(tx, color.g);
+    set_led_byte(tx + BYTES_FOR_LED_BYTE, color.r);
+    set_led_byte(tx + BYTES_FOR_LED_BYTE * 2, color.b);
 }
 
 void ws2812_init(void) {
+    uint8_t* tx   = txbuf;
+    uint16_t used = 0;
+    for (uint8_t c = 0; c < NB_CHAINS; c++) {
+#ifdef WS2812_SPI_CHAIN_PAL_MODES
+        uint8_t pal_mode = chain_pal_mode[c];
+#else
+        uint8_t pal_mode = WS2812_SPI_MOSI_PAL_MODE;
+#endif
 #if defined(USE_GPIOV1)
-    palSetLineMode(RGB_DI_PIN, PAL_MODE_STM32_ALTERNATE_PUSHPULL);
+        (void)pal_mode;
+        palSetLineMode(chain_pin[c], PAL_MODE_STM32_ALTERNATE_PUSHPULL);
 #else
-    palSetLineMode(RGB_DI_PIN, PAL_MODE_ALTERNATE(WS2812_SPI_MOSI_PAL_MODE) | PAL_STM32_OTYPE_PUSHPULL);
+        palSetLineMode(chain_pin[c], PAL_MODE_ALTERNATE(pal_mode) | PAL_STM32_OTYPE_PUSHPULL);
 #endif
 
-    // TODO: more dynamic baudrate
-    static const SPIConfig spicfg = {
-        0, NULL, PAL_PORT(RGB_DI_PIN), PAL_PAD(RGB_DI_PIN),
-        SPI_CR1_BR_1 | SPI_CR1_BR_0  // baudrate : fpclk / 8 => 1tick is 0.32us (2.25 MHz)
-    };
+        // TODO: more dynamic baudrate
+        chain_cfg[c].ssport = PAL_PORT(chain_pin[c]);
+        chain_cfg[c].sspad  = PAL_PAD(chain_pin[c]);
+        chain_cfg[c].cr1    = SPI_CR1_BR_1 | SPI_CR1_BR_0;  // baudrate : fpclk / 8 => 1tick is 0.32us (2.25 MHz)
 
-    spiAcquireBus(&WS2812_SPI);     /* Acquire ownership of the bus.    */
-    spiStart(&WS2812_SPI, &spicfg); /* Setup transfer parameters.       */
-    spiSelect(&WS2812_SPI);         /* Slave Select assertion.          */
+        spiAcquireBus(chain_spi[c]);           /* Acquire ownership of the bus.    */
+        spiStart(chain_spi[c], &chain_cfg[c]); /* Setup transfer parameters.       */
+        spiSelect(chain_spi[c]);               /* Slave Select assertion.          */
+
+        // txbuf only holds RGBLED_NUM LEDs, so chains past that are cut short
+        uint16_t leds = MIN(chain_leds[c], RGBLED_NUM - used);
+        used += leds;
+
+        chain_data[c] = tx + PREAMBLE_SIZE;
+        chain_size[c] = leds;
+        tx += CHAIN_OVERHEAD + BYTES_FOR_LED * leds;
+    }
 }
 
 void ws2812_setleds(LED_TYPE* ledarray, uint16_t leds) {
-    static bool s_init = false;
+    static bool s_init     = false;
+    bool        encode_all = !s_init;
     if (!s_init) {
         ws2812_init();
         s_init = true;
     }
 
-    for (uint8_t i = 0; i < leds; i++) {
-        set_led_color_rgb(ledarray[i], i);
+    uint16_t i = 0;
+    for (uint8_t c = 0; c < NB_CHAINS; c++) {
+        for (uint16_t j = 0; j < chain_size[c] && i < leds; j++, i++) {
+            if (encode_all || memcmp(&ledarray[i], &led_sent[i], sizeof(LED_TYPE)) != 0) {
+                led_sent[i] = ledarray[i];
+                set_led_color_rgb(&chain_data[c][BYTES_FOR_LED * j], ledarray[i]);
+            }
+        }
     }
 
     // Send async - each led takes ~0.03ms, 50 leds ~1.5ms, animations flushing faster than send will cause issues.
     // Instead spiSend can be used to send synchronously (or the thread logic can be added back).
+    // Chains are on separate peripherals, so async sends run in parallel.
+    for (uint8_t c = 0; c < NB_CHAINS; c++) {
+        uint8_t* tx   = chain_data[c] - PREAMBLE_SIZE;
+        size_t   size = CHAIN_OVERHEAD + BYTES_FOR_LED * chain_size[c];
 #ifdef WS2812_SPI_SYNC
-    spiSend(&WS2812_SPI, sizeof(txbuf) / sizeof(txbuf[0]), txbuf);
+        spiSend(chain_spi[c], size, tx);
 #else
-    spiStartSend(&WS2812_SPI, sizeof(txbuf) / sizeof(txbuf[0]), txbuf);
+        spiStartSend(chain_spi[c], size, tx);
 #endif
+    }
 }
@@ -16,6 +16,7 @@
  */
 
 #include "is31fl3731.h"
+#include "issi_flush.h"
 #include "i2c_master.h"
 #include "wait.h"
 
@@ -53,6 +54,12 @@
 #    define ISSI_PERSISTENCE 0
 #endif
 
+// Changes to the PWM registers are tracked in blocks of 16, each run of
+// changed blocks is sent in one I2C transfer by issi_flush().
+#define ISSI_PWM_BLOCK_SIZE ISSI_FLUSH_BLOCK_SIZE
+#define ISSI_PWM_BLOCK_COUNT (144 / ISSI_PWM_BLOCK_SIZE)
+#define ISSI_PWM_BLOCKS_ALL ((1 << ISSI_PWM_BLOCK_COUNT) - 1)
+
 // Transfer buffer for TWITransmitData()
 uint8_t g_twi_transfer_buffer[20];
 
@@ -62,7 +69,9 @@ uint8_t g_twi_transfer_buffer[20];
 // buffers and the transfers in IS31FL3731_write_pwm_buffer() but it's
 // probably not worth the extra complexity.
 uint8_t g_pwm_buffer[DRIVER_COUNT][144];
-bool    g_pwm_buffer_update_required[DRIVER_COUNT] = {false};
+// One bit per 16 register block of g_pwm_buffer, set when a PWM value in
+// that block changes, so an update only sends the blocks that changed.
+uint16_t g_pwm_buffer_dirty[DRIVER_COUNT] = {0};
 
 uint8_t g_led_control_registers[DRIVER_COUNT][18]             = {{0}, {0}};
 bool    g_led_control_registers_update_required[DRIVER_COUNT] = {false};
@@ -94,31 +103,24 @@ void IS31FL3731_write_register(uint8_t addr, uint8_t reg, uint8_t data) {
 #endif
 }
 
-void IS31FL3731_write_pwm_buffer(uint8_t addr, uint8_t *pwm_buffer) {
-    // assumes bank is already selected
-
-    // transmit PWM registers in 9 transfers of 16 bytes
-    // g_twi_transfer_buffer[] is 20 bytes
-
-    // iterate over the pwm_buffer contents at 16 byte intervals
-    for (int i = 0; i < 144; i += 16) {
-        // set the first register, e.g. 0x24, 0x34, 0x44, etc.
-        g_twi_transfer_buffer[0] = 0x24 + i;
-        // copy the data from i to i+15
-        // device will auto-increment register for data after the first byte
-        // thus this sets registers 0x24-0x33, 0x34-0x43, etc. in one transfer
-        for (int j = 0; j < 16; j++) {
-            g_twi_transfer_buffer[1 + j] = pwm_buffer[i + j];
-        }
+static issi_flush_chip_t IS31FL3731_flush_chip(uint8_t addr, uint8_t *pwm_buffer, uint16_t *dirty) {
+    // bank 0 is left selected after init, so no page select is needed
+    return (issi_flush_chip_t){
+        .addr       = addr,
+        .first_reg  = 0x24,
+        .size       = 144,
+        .page       = ISSI_FLUSH_NO_PAGE,
+        .unlock     = false,
+        .pwm_buffer = pwm_buffer,
+        .dirty      = dirty,
+    };
+}
 
-#if ISSI_PERSISTENCE > 0
-        for (uint8_t i = 0; i < ISSI_PERSISTENCE; i++) {
-            if (i2c_transmit(addr << 1, g_twi_transfer_buffer, 17, ISSI_TIMEOUT) == 0) break;
-        }
-#else
-        i2c_transmit(addr << 1, g_twi_transfer_buffer, 17, ISSI_TIMEOUT);
-#endif
-    }
+void IS31FL3731_write_pwm_buffer(uint8_t addr, uint8_t *pwm_buffer) {
+    // transmit all 144 PWM registers, 0x24-0xB3, in one transfer
+    uint16_t          blocks = ISSI_PWM_BLOCKS_ALL;
+    issi_flush_chip_t chip   = IS31FL3731_flush_chip(addr, pwm_buffer, &blocks);
+    issi_flush(&chip, 1);
 }
 
 void IS31FL3731_init(uint8_t addr) {
@@ -173,15 +175,21 @@ void IS31FL3731_init(uint8_t addr) {
     IS31FL3731_write_register(addr, ISSI_COMMANDREGISTER, 0);
 }
 
+static void IS31FL3731_set_pwm(uint8_t driver, uint8_t reg, uint8_t value) {
+    if (g_pwm_buffer[driver][reg] != value) {
+        g_pwm_buffer[driver][reg] = value;
+        g_pwm_buffer_dirty[driver] |= 1 << (reg / ISSI_PWM_BLOCK_SIZE);
+    }
+}
+
 void IS31FL3731_set_color(int index, uint8_t red, uint8_t green, uint8_t blue) {
     if (index >= 0 && index < DRIVER_LED_TOTAL) {
         is31_led led = g_is31_leds[index];
 
         // Subtract 0x24 to get the second index of g_pwm_buffer
-        g_pwm_buffer[led.driver][led.r - 0x24]   = red;
-        g_pwm_buffer[led.driver][led.g - 0x24]   = green;
-        g_pwm_buffer[led.driver][led.b - 0x24]   = blue;
-        g_pwm_buffer_update_required[led.driver] = true;
+        IS31FL3731_set_pwm(led.driver, led.r - 0x24, red);
+        IS31FL3731_set_pwm(led.driver, led.g - 0x24, green);
+        IS31FL3731_set_pwm(led.driver, led.b - 0x24, blue);
     }
 }
 
@@ -221,16 +229,21 @@ void IS31FL3731_set_led_control_register(uint8_t index, bool red, bool green, bo
 }
 
 void IS31FL3731_update_pwm_buffers(uint8_t addr, uint8_t index) {
-    if (g_pwm_buffer_update_required[index]) {
-        IS31FL3731_write_pwm_buffer(addr, g_pwm_buffer[index]);
+    // blocks that failed stay dirty and are sent again on the next update
+    issi_flush_chip_t chip = IS31FL3731_flush_chip(addr, g_pwm_buffer[index], &g_pwm_buffer_dirty[index]);
+    issi_flush(&chip, 1);
+}
+
+void IS31FL3731_update_all_pwm_buffers(const uint8_t *addrs, uint8_t count) {
+    issi_flush_chip_t chips[DRIVER_COUNT];
+    for (uint8_t index = 0; index < count; index++) {
+        chips[index] = IS31FL3731_flush_chip(addrs[index], g_pwm_buffer[index], &g_pwm_buffer_dirty[index]);
     }
-    g_pwm_buffer_update_required[index] = false;
+    issi_flush(chips, count);
 }
 
 void IS31FL3731_update_led_control_registers(uint8_t addr, uint8_t index) {
     if (g_led_control_registers_update_required[index]) {
-        for (int i = 0; i < 18; i++) {
-            IS31FL3731_write_register(addr, i, g_led_control_registers[index][i]);
-        }
+        issi_flush_write(addr, 0x00, g_led_control_registers[index], 18);
     }
 }
@@ -17,8 +17,26 @@
  */
 
 #include "is31fl3733.h"
+#include "issi_flush.h"
 #include "i2c_master.h"
 #include "wait.h"
+#include <string.h>
+
+#ifdef ISSI_ASYNC_FLUSH
+#    ifndef PROTOCOL_CHIBIOS
+#        error "ISSI_ASYNC_FLUSH is only supported on ChibiOS"
+#    endif
+#    include "ch.h"
+#    include "hal.h"
+#    if !I2C_USE_MUTUAL_EXCLUSION
+#        error "ISSI_ASYNC_FLUSH requires I2C_USE_MUTUAL_EXCLUSION in halconf.h"
+#    endif
+// Above the main loop, which never yields. The thread sleeps while the
+// I2C DMA transfers run, so scanning still gets the CPU.
+#    ifndef ISSI_FLUSH_THREAD_PRIORITY
+#        define ISSI_FLUSH_THREAD_PRIORITY (NORMALPRIO + 1)
+#    endif
+#endif
 
 // This is a 7-bit address, that gets left-shifted and bit 0
 // set to 0 for write, 1 for read (as per I2C protocol)
@@ -56,6 +74,12 @@
 #    define ISSI_PERSISTENCE 0
 #endif
 
+// Changes to the PWM registers are tracked in blocks of 16, each run of
+// changed blocks is sent in one I2C transfer by issi_flush().
+#define ISSI_PWM_BLOCK_SIZE ISSI_FLUSH_BLOCK_SIZE
+#define ISSI_PWM_BLOCK_COUNT (192 / ISSI_PWM_BLOCK_SIZE)
+#define ISSI_PWM_BLOCKS_ALL ((1 << ISSI_PWM_BLOCK_COUNT) - 1)
+
 // Transfer buffer for TWITransmitData()
 uint8_t g_twi_transfer_buffer[20];
 
@@ -66,13 +90,45 @@ uint8_t g_twi_transfer_buffer[20];
 // buffers and the transfers in IS31FL3733_write_pwm_buffer() but it's
 // probably not worth the extra complexity.
 uint8_t g_pwm_buffer[DRIVER_COUNT][192];
-bool    g_pwm_buffer_update_required[DRIVER_COUNT] = {false};
+// One bit per 16 register block of g_pwm_buffer, set when a PWM value in
+// that block changes, so an update only sends the blocks that changed.
+uint16_t g_pwm_buffer_dirty[DRIVER_COUNT] = {0};
 
 uint8_t g_led_control_registers[DRIVER_COUNT][24]             = {{0}, {0}};
 bool    g_led_control_registers_update_required[DRIVER_COUNT] = {false};
 
+#ifdef ISSI_ASYNC_FLUSH
+// Second copy of the PWM registers, owned by the flush thread while
+// g_pwm_flush_blocks[index] is non-zero. The I2C driver sends it with DMA
+// and the flush thread sleeps meanwhile, so matrix scanning carries on.
+static uint8_t           g_pwm_flush_buffer[DRIVER_COUNT][192];
+static volatile uint16_t g_pwm_flush_blocks[DRIVER_COUNT];
+static volatile uint16_t g_pwm_flush_failed[DRIVER_COUNT];
+static uint8_t           g_pwm_flush_addr[DRIVER_COUNT];
+static binary_semaphore_t flush_request;
+static THD_WORKING_AREA(waFlushThread, 256);
+static bool flush_thread_started = false;
+
+// Blocks until the flush thread is done with every driver. Only the main
+// loop posts flushes, so the bus, the page selection and the transfer
+// buffer stay with the caller until its next update_pwm_buffers call.
+static void IS31FL3733_flush_wait(void) {
+    for (uint8_t index = 0; index < DRIVER_COUNT; index++) {
+        while (g_pwm_flush_blocks[index]) {
+            chThdSleepMilliseconds(1);
+        }
+    }
+}
+#endif
+
 bool IS31FL3733_write_register(uint8_t addr, uint8_t reg, uint8_t data) {
     // If the transaction fails function returns false.
+#ifdef ISSI_ASYNC_FLUSH
+    IS31FL3733_flush_wait();
+#endif
+    if (reg == ISSI_COMMANDREGISTER) {
+        issi_flush_page_changed(addr);
+    }
     g_twi_transfer_buffer[0] = reg;
     g_twi_transfer_buffer[1] = data;
 
@@ -90,37 +146,74 @@ bool IS31FL3733_write_register(uint8_t addr, uint8_t reg, uint8_t data) {
     return true;
 }
 
+static issi_flush_chip_t IS31FL3733_flush_chip(uint8_t addr, uint8_t *pwm_buffer, uint16_t *dirty) {
+    return (issi_flush_chip_t){
+        .addr       = addr,
+        .first_reg  = 0x00,
+        .size       = 192,
+        .page       = ISSI_PAGE_PWM,
+        .unlock     = true,
+        .pwm_buffer = pwm_buffer,
+        .dirty      = dirty,
+    };
+}
+
 bool IS31FL3733_write_pwm_buffer(uint8_t addr, uint8_t *pwm_buffer) {
     // Assumes PG1 is already selected.
     // If any of the transactions fails function returns false.
-    // Transmit PWM registers in 12 transfers of 16 bytes.
-    // g_twi_transfer_buffer[] is 20 bytes
-
-    // Iterate over the pwm_buffer contents at 16 byte intervals.
-    for (int i = 0; i < 192; i += 16) {
-        g_twi_transfer_buffer[0] = i;
-        // Copy the data from i to i+15.
-        // Device will auto-increment register for data after the first byte
-        // Thus this sets registers 0x00-0x0F, 0x10-0x1F, etc. in one transfer.
-        for (int j = 0; j < 16; j++) {
-            g_twi_transfer_buffer[1 + j] = pwm_buffer[i + j];
-        }
+    // Transmit all 192 PWM registers in one transfer.
+#ifdef ISSI_ASYNC_FLUSH
+    IS31FL3733_flush_wait();
+#endif
+    uint16_t          blocks = ISSI_PWM_BLOCKS_ALL;
+    issi_flush_chip_t chip   = IS31FL3733_flush_chip(addr, pwm_buffer, &blocks);
+    chip.page                = ISSI_FLUSH_NO_PAGE;
+    return issi_flush(&chip, 1);
+}
 
-#if ISSI_PERSISTENCE > 0
-        for (uint8_t i = 0; i < ISSI_PERSISTENCE; i++) {
-            if (i2c_transmit(addr << 1, g_twi_transfer_buffer, 17, ISSI_TIMEOUT) != 0) {
-                return false;
+#ifdef ISSI_ASYNC_FLUSH
+static THD_FUNCTION(IS31FL3733_flush_thread, arg) {
+    (void)arg;
+    chRegSetThreadName("issi_flush");
+
+    while (true) {
+        chBSemWait(&flush_request);
+
+        // Every driver handed over so far goes out in one interleaved flush
+        issi_flush_chip_t chips[DRIVER_COUNT];
+        uint16_t          blocks[DRIVER_COUNT];
+        uint8_t           taken = 0;
+        for (uint8_t index = 0; index < DRIVER_COUNT; index++) {
+            blocks[index] = g_pwm_flush_blocks[index];
+            chips[index]  = IS31FL3733_flush_chip(g_pwm_flush_addr[index], g_pwm_flush_buffer[index], &blocks[index]);
+            if (blocks[index]) {
+                taken |= 1 << index;
             }
         }
-#else
-        if (i2c_transmit(addr << 1, g_twi_transfer_buffer, 17, ISSI_TIMEOUT) != 0) {
-            return false;
+        issi_flush(chips, DRIVER_COUNT);
+
+        // Hand the buffers back, along with any blocks that failed
+        chSysLock();
+        for (uint8_t index = 0; index < DRIVER_COUNT; index++) {
+            if (taken & (1 << index)) {
+                g_pwm_flush_failed[index] |= blocks[index];
+                g_pwm_flush_blocks[index] = 0;
+            }
         }
-#endif
+        chSysUnlock();
+    }
+}
+
+static void IS31FL3733_flush_start(void) {
+    if (!flush_thread_started) {
+        chBSemObjectInit(&flush_request, true);
+        chThdCreateStatic(waFlushThread, sizeof(waFlushThread), ISSI_FLUSH_THREAD_PRIORITY, IS31FL3733_flush_thread, NULL);
+        flush_thread_started = true;
     }
-    return true;
 }
 
+#endif
+
 void IS31FL3733_init(uint8_t addr, uint8_t sync) {
     // In order to avoid the LEDs being driven with garbage data
     // in the LED driver's PWM registers, shutdown is enabled last.
@@ -128,6 +221,11 @@ void IS31FL3733_init(uint8_t addr, uint8_t sync) {
     // then disable software shutdown.
     // Sync is passed so set it according to the datasheet.
 
+#ifdef ISSI_ASYNC_FLUSH
+    IS31FL3733_flush_start();
+    IS31FL3733_flush_wait();
+#endif
+
     // Unlock the command register.
     IS31FL3733_write_register(addr, ISSI_COMMANDREGISTER_WRITELOCK, 0xC5);
 
@@ -163,14 +261,20 @@ void IS31FL3733_init(uint8_t addr, uint8_t sync) {
     wait_ms(10);
 }
 
+static void IS31FL3733_set_pwm(uint8_t driver, uint8_t reg, uint8_t value) {
+    if (g_pwm_buffer[driver][reg] != value) {
+        g_pwm_buffer[driver][reg] = value;
+        g_pwm_buffer_dirty[driver] |= 1 << (reg / ISSI_PWM_BLOCK_SIZE);
+    }
+}
+
 void IS31FL3733_set_color(int index, uint8_t red, uint8_t green, uint8_t blue) {
     if (index >= 0 && index < DRIVER_LED_TOTAL) {
         is31_led led = g_is31_leds[index];
 
-        g_pwm_buffer[led.driver][led.r]          = red;
-        g_pwm_buffer[led.driver][led.g]          = green;
-        g_pwm_buffer[led.driver][led.b]          = blue;
-        g_pwm_buffer_update_required[led.driver] = true;
+        IS31FL3733_set_pwm(led.driver, led.r, red);
+        IS31FL3733_set_pwm(led.driver, led.g, green);
+        IS31FL3733_set_pwm(led.driver, led.b, blue);
     }
 }
 
@@ -209,29 +313,92 @@ void IS31FL3733_set_led_control_register(uint8_t index, bool red, bool green, bo
     g_led_control_registers_update_required[led.driver] = true;
 }
 
+#ifdef ISSI_ASYNC_FLUSH
+// Hands the changed blocks of a driver to the flush thread, returns false
+// if there was nothing to send.
+static bool IS31FL3733_flush_post(uint8_t addr, uint8_t index) {
+    // The previous frame is still being sent, keep the changes for the next one
+    if (g_pwm_flush_blocks[index]) {
+        return false;
+    }
+
+    if (g_pwm_flush_failed[index]) {
+        g_pwm_buffer_dirty[index] |= g_pwm_flush_failed[index];
+        g_pwm_flush_failed[index]                      = 0;
+        g_led_control_registers_update_required[index] = true;
+    }
+
+    uint16_t blocks = g_pwm_buffer_dirty[index];
+    if (!blocks) {
+        return false;
+    }
+
+    // Only the changed blocks are copied, the rest of the flush buffer
+    // already matches what the driver holds
+    for (uint8_t block = 0; block < ISSI_PWM_BLOCK_COUNT; block++) {
+        if (blocks & (1 << block)) {
+            memcpy(&g_pwm_flush_buffer[index][block * ISSI_PWM_BLOCK_SIZE], &g_pwm_buffer[index][block * ISSI_PWM_BLOCK_SIZE], ISSI_PWM_BLOCK_SIZE);
+        }
+    }
+    g_pwm_buffer_dirty[index] = 0;
+    g_pwm_flush_addr[index]   = addr;
+    g_pwm_flush_blocks[index] = blocks;
+    return true;
+}
+
 void IS31FL3733_update_pwm_buffers(uint8_t addr, uint8_t index) {
-    if (g_pwm_buffer_update_required[index]) {
-        // Firstly we need to unlock the command register and select PG1.
-        IS31FL3733_write_register(addr, ISSI_COMMANDREGISTER_WRITELOCK, 0xC5);
-        IS31FL3733_write_register(addr, ISSI_COMMANDREGISTER, ISSI_PAGE_PWM);
+    if (IS31FL3733_flush_post(addr, index)) {
+        chBSemSignal(&flush_request);
+    }
+}
+
+void IS31FL3733_update_all_pwm_buffers(const uint8_t *addrs, uint8_t count) {
+    // The thread runs above the main loop, so wake it once with every
+    // driver posted rather than once per driver
+    bool posted = false;
+    for (uint8_t index = 0; index < count; index++) {
+        posted |= IS31FL3733_flush_post(addrs[index], index);
+    }
+    if (posted) {
+        chBSemSignal(&flush_request);
+    }
+}
+#else
+void IS31FL3733_update_pwm_buffers(uint8_t addr, uint8_t index) {
+    // The unlock and PG1 select are only sent if another page was selected since.
+    // Blocks that failed stay dirty and are sent again on the next update.
+    // If any of the transactions fail we risk writing dirty PG0,
+    // refresh page 0 just in case.
+    issi_flush_chip_t chip = IS31FL3733_flush_chip(addr, g_pwm_buffer[index], &g_pwm_buffer_dirty[index]);
+    if (!issi_flush(&chip, 1)) {
+        g_led_control_registers_update_required[index] = true;
+    }
+}
 
-        // If any of the transactions fail we risk writing dirty PG0,
-        // refresh page 0 just in case.
-        if (!IS31FL3733_write_pwm_buffer(addr, g_pwm_buffer[index])) {
-            g_led_control_registers_update_required[index] = true;
+void IS31FL3733_update_all_pwm_buffers(const uint8_t *addrs, uint8_t count) {
+    issi_flush_chip_t chips[DRIVER_COUNT];
+    for (uint8_t index = 0; index < count; index++) {
+        chips[index] = IS31FL3733_flush_chip(addrs[index], g_pwm_buffer[index], &g_pwm_buffer_dirty[index]);
+    }
+    if (!issi_flush(chips, count)) {
+        for (uint8_t index = 0; index < count; index++) {
+            if (g_pwm_buffer_dirty[index]) {
+                g_led_control_registers_update_required[index] = true;
+            }
         }
     }
-    g_pwm_buffer_update_required[index] = false;
 }
+#endif
 
 void IS31FL3733_update_led_control_registers(uint8_t addr, uint8_t index) {
     if (g_led_control_registers_update_required[index]) {
+#ifdef ISSI_ASYNC_FLUSH
+        IS31FL3733_flush_wait();
+#endif
         // Firstly we need to unlock the command register and select PG0
         IS31FL3733_write_register(addr, ISSI_COMMANDREGISTER_WRITELOCK, 0xC5);
         IS31FL3733_write_register(addr, ISSI_COMMANDREGISTER, ISSI_PAGE_LEDCONTROL);
-        for (int i = 0; i < 24; i++) {
-            IS31FL3733_write_register(addr, i, g_led_control_registers[index][i]);
-        }
+        issi_flush_write(addr, 0x00, g_led_control_registers[index], 24);
     }
     g_led_control_registers_update_required[index] = false;
 }
@@ -45,6 +45,9 @@ void IS31FL3733_set_led_control_register(uint8_t index, bool red, bool green, bo
 // If the buffer is dirty, it will update the driver with the buffer.
 void IS31FL3733_update_pwm_buffers(uint8_t addr, uint8_t index);
 void IS31FL3733_update_led_control_registers(uint8_t addr, uint8_t index);
+// Same as above for drivers 0 to count - 1 at addrs[0] to addrs[count - 1],
+// with their transfers interleaved on the bus.
+void IS31FL3733_update_all_pwm_buffers(const uint8_t *addrs, uint8_t count);
 
 #define A_1 0x00
 #define A_2 0x01
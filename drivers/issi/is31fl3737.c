@@ -17,6 +17,7 @@
  */
 
 #include "is31fl3737.h"
+#include "issi_flush.h"
 #include "i2c_master.h"
 #include "wait.h"
 
@@ -56,6 +57,12 @@
 #    define ISSI_PERSISTENCE 0
 #endif
 
+// Changes to the PWM registers are tracked in blocks of 16, each run of
+// changed blocks is sent in one I2C transfer by issi_flush().
+#define ISSI_PWM_BLOCK_SIZE ISSI_FLUSH_BLOCK_SIZE
+#define ISSI_PWM_BLOCK_COUNT (192 / ISSI_PWM_BLOCK_SIZE)
+#define ISSI_PWM_BLOCKS_ALL ((1 << ISSI_PWM_BLOCK_COUNT) - 1)
+
 // Transfer buffer for TWITransmitData()
 uint8_t g_twi_transfer_buffer[20];
 
@@ -66,12 +73,17 @@ uint8_t g_twi_transfer_buffer[20];
 // buffers and the transfers in IS31FL3737_write_pwm_buffer() but it's
 // probably not worth the extra complexity.
 uint8_t g_pwm_buffer[DRIVER_COUNT][192];
-bool    g_pwm_buffer_update_required = false;
+// One bit per 16 register block of g_pwm_buffer, set when a PWM value in
+// that block changes, so an update only sends the blocks that changed.
+uint16_t g_pwm_buffer_dirty[DRIVER_COUNT] = {0};
 
 uint8_t g_led_control_registers[DRIVER_COUNT][24] = {{0}};
 bool    g_led_control_registers_update_required   = false;
 
 void IS31FL3737_write_register(uint8_t addr, uint8_t reg, uint8_t data) {
+    if (reg == ISSI_COMMANDREGISTER) {
+        issi_flush_page_changed(addr);
+    }
     g_twi_transfer_buffer[0] = reg;
     g_twi_transfer_buffer[1] = data;
 
@@ -84,30 +96,26 @@ void IS31FL3737_write_register(uint8_t addr, uint8_t reg, uint8_t data) {
 #endif
 }
 
+static issi_flush_chip_t IS31FL3737_flush_chip(uint8_t addr, uint8_t *pwm_buffer, uint16_t *dirty) {
+    return (issi_flush_chip_t){
+        .addr       = addr,
+        .first_reg  = 0x00,
+        .size       = 192,
+        .page       = ISSI_PAGE_PWM,
+        .unlock     = true,
+        .pwm_buffer = pwm_buffer,
+        .dirty      = dirty,
+    };
+}
+
 void IS31FL3737_write_pwm_buffer(uint8_t addr, uint8_t *pwm_buffer) {
     // assumes PG1 is already selected
 
-    // transmit PWM registers in 12 transfers of 16 bytes
-    // g_twi_transfer_buffer[] is 20 bytes
-
-    // iterate over the pwm_buffer contents at 16 byte intervals
-    for (int i = 0; i < 192; i += 16) {
-        g_twi_transfer_buffer[0] = i;
-        // copy the data from i to i+15
-        // device will auto-increment register for data after the first byte
-        // thus this sets registers 0x00-0x0F, 0x10-0x1F, etc. in one transfer
-        for (int j = 0; j < 16; j++) {
-            g_twi_transfer_buffer[1 + j] = pwm_buffer[i + j];
-        }
-
-#if ISSI_PERSISTENCE > 0
-        for (uint8_t i = 0; i < ISSI_PERSISTENCE; i++) {
-            if (i2c_transmit(addr << 1, g_twi_transfer_buffer, 17, ISSI_TIMEOUT) == 0) break;
-        }
-#else
-        i2c_transmit(addr << 1, g_twi_transfer_buffer, 17, ISSI_TIMEOUT);
-#endif
-    }
+    // transmit all 192 PWM registers in one transfer
+    uint16_t          blocks = ISSI_PWM_BLOCKS_ALL;
+    issi_flush_chip_t chip   = IS31FL3737_flush_chip(addr, pwm_buffer, &blocks);
+    chip.page                = ISSI_FLUSH_NO_PAGE;
+    issi_flush(&chip, 1);
 }
 
 void IS31FL3737_init(uint8_t addr) {
@@ -151,14 +159,20 @@ void IS31FL3737_init(uint8_t addr) {
     wait_ms(10);
 }
 
+static void IS31FL3737_set_pwm(uint8_t driver, uint8_t reg, uint8_t value) {
+    if (g_pwm_buffer[driver][reg] != value) {
+        g_pwm_buffer[driver][reg] = value;
+        g_pwm_buffer_dirty[driver] |= 1 << (reg / ISSI_PWM_BLOCK_SIZE);
+    }
+}
+
 void IS31FL3737_set_color(int index, uint8_t red, uint8_t green, uint8_t blue) {
     if (index >= 0 && index < DRIVER_LED_TOTAL) {
         is31_led led = g_is31_leds[index];
 
-        g_pwm_buffer[led.driver][led.r] = red;
-        g_pwm_buffer[led.driver][led.g] = green;
-        g_pwm_buffer[led.driver][led.b] = blue;
-        g_pwm_buffer_update_required    = true;
+        IS31FL3737_set_pwm(led.driver, led.r, red);
+        IS31FL3737_set_pwm(led.driver, led.g, green);
+        IS31FL3737_set_pwm(led.driver, led.b, blue);
     }
 }
 
@@ -198,15 +212,13 @@ void IS31FL3737_set_led_control_register(uint8_t index, bool red, bool green, bo
 }
 
 void IS31FL3737_update_pwm_buffers(uint8_t addr1, uint8_t addr2) {
-    if (g_pwm_buffer_update_required) {
-        // Firstly we need to unlock the command register and select PG1
-        IS31FL3737_write_register(addr1, ISSI_COMMANDREGISTER_WRITELOCK, 0xC5);
-        IS31FL3737_write_register(addr1, ISSI_COMMANDREGISTER, ISSI_PAGE_PWM);
-
-        IS31FL3737_write_pwm_buffer(addr1, g_pwm_buffer[0]);
-        // IS31FL3737_write_pwm_buffer(addr2, g_pwm_buffer[1]);
-    }
-    g_pwm_buffer_update_required = false;
+    // The unlock and PG1 select are only sent if another page was selected
+    // since, blocks that failed stay dirty for the next update
+    issi_flush_chip_t chips[] = {
+        IS31FL3737_flush_chip(addr1, g_pwm_buffer[0], &g_pwm_buffer_dirty[0]),
+        // IS31FL3737_flush_chip(addr2, g_pwm_buffer[1], &g_pwm_buffer_dirty[1]),
+    };
+    issi_flush(chips, sizeof(chips) / sizeof(chips[0]));
 }
 
 void IS31FL3737_update_led_control_registers(uint8_t addr1, uint8_t addr2) {
@@ -214,9 +226,7 @@ void IS31FL3737_update_led_control_registers(uint8_t addr1, uint8_t addr2) {
         // Firstly we need to unlock the command register and select PG0
         IS31FL3737_write_register(addr1, ISSI_COMMANDREGISTER_WRITELOCK, 0xC5);
         IS31FL3737_write_register(addr1, ISSI_COMMANDREGISTER, ISSI_PAGE_LEDCONTROL);
-        for (int i = 0; i < 24; i++) {
-            IS31FL3737_write_register(addr1, i, g_led_control_registers[0][i]);
-            // IS31FL3737_write_register(addr2, i, g_led_control_registers[1][i]);
-        }
+        issi_flush_write(addr1, 0x00, g_led_control_registers[0], 24);
+        // issi_flush_write(addr2, 0x00, g_led_control_registers[1], 24);
     }
 }
@@ -0,0 +1,140 @@
+#include "issi_flush.h"
+#include "i2c_master.h"
+#include <string.h>
+
+#ifndef ISSI_TIMEOUT
+#    define ISSI_TIMEOUT 100
+#endif
+
+#ifndef ISSI_PERSISTENCE
+#    define ISSI_PERSISTENCE 0
+#endif
+
+#define ISSI_COMMANDREGISTER 0xFD
+#define ISSI_COMMANDREGISTER_WRITELOCK 0xFE
+#define ISSI_COMMANDREGISTER_UNLOCK 0xC5
+
+_Static_assert(ISSI_FLUSH_MAX_BURST >= ISSI_FLUSH_BLOCK_SIZE && ISSI_FLUSH_MAX_BURST % ISSI_FLUSH_BLOCK_SIZE == 0, "ISSI_FLUSH_MAX_BURST must be a multiple of ISSI_FLUSH_BLOCK_SIZE");
+_Static_assert(ISSI_FLUSH_MAX_BURST <= UINT8_MAX, "ISSI_FLUSH_MAX_BURST must fit one register page");
+
+#ifndef __AVR__
+// Register address followed by the burst, sent in one transfer
+static uint8_t g_flush_transfer_buffer[1 + ISSI_FLUSH_MAX_BURST];
+#endif
+
+// One bit per 7-bit address, set while that chip is known to have its PWM
+// page selected, so the unlock and page select are only sent when needed
+static uint8_t g_pwm_page_selected[128 / 8];
+
+static bool issi_flush_page_selected(uint8_t addr) { return g_pwm_page_selected[addr / 8] & (1 << (addr % 8)); }
+
+void issi_flush_page_changed(uint8_t addr) { g_pwm_page_selected[addr / 8] &= ~(1 << (addr % 8)); }
+
+static bool issi_flush_transmit(uint8_t addr, uint8_t reg, const uint8_t *data, uint8_t len) {
+#ifdef __AVR__
+    // The AVR driver sends byte by byte, so the burst is not copied.
+    return i2c_writeReg(addr << 1, reg, data, len, ISSI_TIMEOUT) == I2C_STATUS_SUCCESS;
+#else
+    g_flush_transfer_buffer[0] = reg;
+    memcpy(&g_flush_transfer_buffer[1], data, len);
+    return i2c_transmit(addr << 1, g_flush_transfer_buffer, len + 1, ISSI_TIMEOUT) == I2C_STATUS_SUCCESS;
+#endif
+}
+
+// Gives up after ISSI_PERSISTENCE attempts, the caller keeps the data dirty
+static bool issi_flush_send(uint8_t addr, uint8_t reg, const uint8_t *data, uint8_t len) {
+#if ISSI_PERSISTENCE > 0
+    for (uint8_t i = 0; i < ISSI_PERSISTENCE; i++) {
+        if (issi_flush_transmit(addr, reg, data, len)) {
+            return true;
+        }
+    }
+    return false;
+#else
+    return issi_flush_transmit(addr, reg, data, len);
+#endif
+}
+
+bool issi_flush_write(uint8_t addr, uint8_t reg, const uint8_t *data, uint8_t len) {
+    while (len > 0) {
+        uint8_t chunk = len < ISSI_FLUSH_MAX_BURST ? len : ISSI_FLUSH_MAX_BURST;
+        if (!issi_flush_send(addr, reg, data, chunk)) {
+            return false;
+        }
+        reg += chunk;
+        data += chunk;
+        len -= chunk;
+    }
+    return true;
+}
+
+static bool issi_flush_select_page(const issi_flush_chip_t *chip) {
+    if (chip->page == ISSI_FLUSH_NO_PAGE || issi_flush_page_selected(chip->addr)) {
+        return true;
+    }
+
+    static const uint8_t unlock = ISSI_COMMANDREGISTER_UNLOCK;
+    if (chip->unlock && !issi_flush_send(chip->addr, ISSI_COMMANDREGISTER_WRITELOCK, &unlock, 1)) {
+        return false;
+    }
+    if (!issi_flush_send(chip->addr, ISSI_COMMANDREGISTER, &chip->page, 1)) {
+        return false;
+    }
+    g_pwm_page_selected[chip->addr / 8] |= 1 << (chip->addr % 8);
+    return true;
+}
+
+// Sends the chip's first run of dirty blocks in one transfer
+static bool issi_flush_burst(const issi_flush_chip_t *chip) {
+    if (!issi_flush_select_page(chip)) {
+        return false;
+    }
+
+    uint16_t dirty  = *chip->dirty;
+    uint8_t  blocks = chip->size / ISSI_FLUSH_BLOCK_SIZE;
+    uint8_t  first  = 0;
+    while (!(dirty & (1 << first))) {
+        first++;
+    }
+    uint8_t last = first + 1;
+    while (last < blocks && (dirty & (1 << last)) && (last - first) * ISSI_FLUSH_BLOCK_SIZE < ISSI_FLUSH_MAX_BURST) {
+        last++;
+    }
+
+    uint8_t offset = first * ISSI_FLUSH_BLOCK_SIZE;
+    if (!issi_flush_send(chip->addr, chip->first_reg + offset, &chip->pwm_buffer[offset], (last - first) * ISSI_FLUSH_BLOCK_SIZE)) {
+        // The chip may have been reset, select its page again next time.
+        issi_flush_page_changed(chip->addr);
+        return false;
+    }
+    *chip->dirty &= ~(((1 << (last - first)) - 1) << first);
+    return true;
+}
+
+bool issi_flush(const issi_flush_chip_t *chips, uint8_t count) {
+    uint8_t pending = 0;
+    bool    success = true;
+
+    for (uint8_t i = 0; i < count; i++) {
+        if (*chips[i].dirty) {
+            pending |= 1 << i;
+        }
+    }
+
+    // One burst per chip per round, so a change on the last chip does not
+    // wait for every block of the others.
+    while (pending) {
+        for (uint8_t i = 0; i < count; i++) {
+            if (!(pending & (1 << i))) {
+                continue;
+            }
+            if (!issi_flush_burst(&chips[i])) {
+                success = false;
+                pending &= ~(1 << i);
+            } else if (!*chips[i].dirty) {
+                pending &= ~(1 << i);
+            }
+        }
+    }
+    return success;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Sends the PWM registers of several ISSI chips on one bus. Runs of dirty
+// blocks go out as single auto-increment transfers, the chips take turns
+// burst by burst and chips with nothing dirty are not addressed at all.
+
+// Dirty bits cover this many PWM registers each
+#define ISSI_FLUSH_BLOCK_SIZE 16
+
+// Longest run of registers sent in one transfer
+#ifndef ISSI_FLUSH_MAX_BURST
+#    define ISSI_FLUSH_MAX_BURST 192
+#endif
+
+// No page select is needed to reach the PWM registers
+#define ISSI_FLUSH_NO_PAGE 0xFF
+
+typedef struct {
+    uint8_t   addr;        // 7-bit I2C address
+    uint8_t   first_reg;   // register holding pwm_buffer[0]
+    uint8_t   size;        // number of PWM registers, a multiple of ISSI_FLUSH_BLOCK_SIZE
+    uint8_t   page;        // page holding the PWM registers, or ISSI_FLUSH_NO_PAGE
+    bool      unlock;      // the command register needs unlocking before a page select
+    uint8_t * pwm_buffer;  // the PWM registers as they should be
+    uint16_t *dirty;       // one bit per block, cleared as blocks are sent
+} issi_flush_chip_t;
+
+// Writes len registers from reg in one transfer, making up to
+// ISSI_PERSISTENCE attempts (one if it is 0). Returns false if every
+// attempt failed.
+bool issi_flush_write(uint8_t addr, uint8_t reg, const uint8_t *data, uint8_t len);
+
+// Sends the dirty blocks of count chips. Blocks that fail stay dirty and
+// the chip is left alone until the next call. Returns false if any failed.
+bool issi_flush(const issi_flush_chip_t *chips, uint8_t count);
+
+// Forgets which page the chip at addr has selected. Drivers call this when
+// they write the command register themselves.
+void issi_flush_page_changed(uint8_t addr);
@@ -0,0 +1,193 @@
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include <vector>
+extern "C" {
+#include "issi_flush.h"
+#include "i2c_master.h"
+}
+
+using testing::ElementsAre;
+
+struct Transfer {
+    uint8_t              addr;
+    uint8_t              reg;
+    std::vector<uint8_t> data;
+};
+
+static const uint8_t ADDR_A = 0x50;
+static const uint8_t ADDR_B = 0x53;
+
+static std::vector<Transfer> transfers;
+static uint8_t               failing_addr = 0;
+
+extern "C" i2c_status_t i2c_transmit(uint8_t address, const uint8_t* data, uint16_t length, uint16_t timeout) {
+    if ((address >> 1) == failing_addr) {
+        return I2C_STATUS_ERROR;
+    }
+    transfers.push_back({(uint8_t)(address >> 1), data[0], std::vector<uint8_t>(data + 1, data + length)});
+    return I2C_STATUS_SUCCESS;
+}
+
+extern "C" i2c_status_t i2c_writeReg(uint8_t devaddr, uint8_t regaddr, const uint8_t* data, uint16_t length, uint16_t timeout) {
+    uint8_t packet[length + 1];
+    packet[0] = regaddr;
+    memcpy(&packet[1], data, length);
+    return i2c_transmit(devaddr, packet, length + 1, timeout);
+}
+
+// Address byte, register byte and data, leaving out start and stop
+static size_t bytes_on_wire(void) {
+    size_t bytes = 0;
+    for (auto& t : transfers) {
+        bytes += 2 + t.data.size();
+    }
+    return bytes;
+}
+
+static std::vector<uint8_t> registers_sent(uint8_t addr) {
+    std::vector<uint8_t> regs;
+    for (auto& t : transfers) {
+        if (t.addr == addr) regs.push_back(t.reg);
+    }
+    return regs;
+}
+
+class IssiFlush : public testing::Test {
+   protected:
+    uint8_t  pwm[2][192];
+    uint16_t dirty[2];
+
+    void SetUp() override {
+        transfers.clear();
+        failing_addr = 0;
+        issi_flush_page_changed(ADDR_A);
+        issi_flush_page_changed(ADDR_B);
+        for (int i = 0; i < 192; i++) {
+            pwm[0][i] = i;
+            pwm[1][i] = 255 - i;
+        }
+        dirty[0] = dirty[1] = 0;
+    }
+
+    issi_flush_chip_t chip(uint8_t index) {
+        return {
+            .addr       = index ? ADDR_B : ADDR_A,
+            .first_reg  = 0x00,
+            .size       = 192,
+            .page       = 0x01,
+            .unlock     = true,
+            .pwm_buffer = pwm[index],
+            .dirty      = &dirty[index],
+        };
+    }
+};
+
+TEST_F(IssiFlush, unchanged_chips_are_not_addressed) {
+    issi_flush_chip_t chips[] = {chip(0), chip(1)};
+    EXPECT_TRUE(issi_flush(chips, 2));
+    EXPECT_TRUE(transfers.empty());
+}
+
+TEST_F(IssiFlush, full_frame_is_one_burst) {
+    issi_flush_chip_t chips[] = {chip(0)};
+    dirty[0]                  = 0x0FFF;
+    EXPECT_TRUE(issi_flush(chips, 1));
+    ASSERT_EQ(transfers.size(), 3u);
+    EXPECT_EQ(transfers[0].reg, 0xFE);
+    EXPECT_THAT(transfers[0].data, ElementsAre(0xC5));
+    EXPECT_EQ(transfers[1].reg, 0xFD);
+    EXPECT_THAT(transfers[1].data, ElementsAre(0x01));
+    EXPECT_EQ(transfers[2].reg, 0x00);
+    EXPECT_EQ(transfers[2].data, std::vector<uint8_t>(pwm[0], pwm[0] + 192));
+    EXPECT_EQ(dirty[0], 0);
+    // twelve 16 register transfers and the page select took 14 transfers, 222 bytes
+    EXPECT_EQ(bytes_on_wire(), 200u);
+}
+
+TEST_F(IssiFlush, page_select_is_only_sent_once) {
+    issi_flush_chip_t chips[] = {chip(0)};
+    dirty[0]                  = 0x0FFF;
+    issi_flush(chips, 1);
+    transfers.clear();
+    dirty[0] = 0x0FFF;
+    issi_flush(chips, 1);
+    EXPECT_EQ(transfers.size(), 1u);
+    EXPECT_EQ(bytes_on_wire(), 194u);
+}
+
+TEST_F(IssiFlush, page_change_selects_page_again) {
+    issi_flush_chip_t chips[] = {chip(0)};
+    dirty[0]                  = 0x0001;
+    issi_flush(chips, 1);
+    issi_flush_page_changed(ADDR_A);
+    transfers.clear();
+    dirty[0] = 0x0001;
+    issi_flush(chips, 1);
+    EXPECT_THAT(registers_sent(ADDR_A), ElementsAre(0xFE, 0xFD, 0x00));
+}
+
+TEST_F(IssiFlush, runs_of_dirty_blocks_are_coalesced) {
+    issi_flush_chip_t chips[] = {chip(0)};
+    dirty[0]                  = 0x0865;  // blocks 0, 2, 5-6 and 11
+    EXPECT_TRUE(issi_flush(chips, 1));
+    EXPECT_THAT(registers_sent(ADDR_A), ElementsAre(0xFE, 0xFD, 0x00, 0x20, 0x50, 0xB0));
+    EXPECT_EQ(transfers[4].data.size(), 32u);
+    EXPECT_EQ(transfers[4].data, std::vector<uint8_t>(pwm[0] + 0x50, pwm[0] + 0x70));
+    EXPECT_EQ(dirty[0], 0);
+}
+
+TEST_F(IssiFlush, chips_take_turns) {
+    issi_flush_chip_t chips[] = {chip(0), chip(1)};
+    dirty[0]                  = 0x0005;
+    dirty[1]                  = 0x0050;
+    EXPECT_TRUE(issi_flush(chips, 2));
+    std::vector<uint8_t> order;
+    for (auto& t : transfers) {
+        if (t.reg < 0xFD) order.push_back(t.addr);
+    }
+    EXPECT_THAT(order, ElementsAre(ADDR_A, ADDR_B, ADDR_A, ADDR_B));
+}
+
+TEST_F(IssiFlush, only_changed_chip_is_sent) {
+    issi_flush_chip_t chips[] = {chip(0), chip(1)};
+    dirty[1]                  = 0x0400;
+    EXPECT_TRUE(issi_flush(chips, 2));
+    EXPECT_TRUE(registers_sent(ADDR_A).empty());
+    EXPECT_THAT(registers_sent(ADDR_B), ElementsAre(0xFE, 0xFD, 0xA0));
+}
+
+TEST_F(IssiFlush, failed_chip_keeps_its_blocks) {
+    issi_flush_chip_t chips[] = {chip(0), chip(1)};
+    dirty[0]                  = 0x0003;
+    dirty[1]                  = 0x0003;
+    failing_addr              = ADDR_A;
+    EXPECT_FALSE(issi_flush(chips, 2));
+    EXPECT_EQ(dirty[0], 0x0003);
+    EXPECT_EQ(dirty[1], 0);
+
+    failing_addr = 0;
+    transfers.clear();
+    EXPECT_TRUE(issi_flush(chips, 2));
+    EXPECT_THAT(registers_sent(ADDR_A), ElementsAre(0xFE, 0xFD, 0x00));
+    EXPECT_EQ(dirty[0], 0);
+}
+
+TEST_F(IssiFlush, registers_are_offset_without_page_select) {
+    issi_flush_chip_t chips[] = {chip(0)};
+    chips[0].first_reg        = 0x24;
+    chips[0].size             = 144;
+    chips[0].page             = ISSI_FLUSH_NO_PAGE;
+    chips[0].unlock           = false;
+    dirty[0]                  = 0x01FF;
+    EXPECT_TRUE(issi_flush(chips, 1));
+    ASSERT_EQ(transfers.size(), 1u);
+    EXPECT_EQ(transfers[0].reg, 0x24);
+    EXPECT_EQ(transfers[0].data.size(), 144u);
+}
+
+TEST_F(IssiFlush, long_writes_are_split) {
+    uint8_t data[200] = {0};
+    EXPECT_TRUE(issi_flush_write(ADDR_A, 0x10, data, sizeof(data)));
+    EXPECT_THAT(registers_sent(ADDR_A), ElementsAre(0x10, 0x10 + ISSI_FLUSH_MAX_BURST));
+    EXPECT_EQ(transfers[1].data.size(), 200u - ISSI_FLUSH_MAX_BURST);
+}
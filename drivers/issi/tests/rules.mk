@@ -0,0 +1,4 @@
+issi_flush_INC := $(DRIVER_PATH)/issi/tests
+issi_flush_SRC :=\
+	$(DRIVER_PATH)/issi/tests/issi_flush_tests.cpp \
+	$(DRIVER_PATH)/issi/issi_flush.c
@@ -0,0 +1,2 @@
+TEST_LIST +=\
+	issi_flush
@@ -14,7 +14,11 @@ GNU General Public License for more details.
 You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
-#include "i2c_master.h"
+#if defined(OLED_TRANSPORT_SPI)
+#    include "quantum.h"
+#else
+#    include "i2c_master.h"
+#endif
 #include "oled_driver.h"
 #include OLED_FONT_H
 #include "timer.h"
@@ -24,8 +28,85 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "progmem.h"
 
+#ifdef OLED_ASYNC_RENDER
+#    ifndef PROTOCOL_CHIBIOS
+#        error "OLED_ASYNC_RENDER is only supported on ChibiOS"
+#    endif
+#    include "ch.h"
+#    include "hal.h"
+#    if defined(OLED_TRANSPORT_SPI) && !SPI_USE_MUTUAL_EXCLUSION
+#        error "OLED_ASYNC_RENDER requires SPI_USE_MUTUAL_EXCLUSION in halconf.h"
+#    elif !defined(OLED_TRANSPORT_SPI) && !I2C_USE_MUTUAL_EXCLUSION
+#        error "OLED_ASYNC_RENDER requires I2C_USE_MUTUAL_EXCLUSION in halconf.h"
+#    endif
+// Above the main loop, which never yields. The thread sleeps while the
+// DMA transfers run, so scanning still gets the CPU.
+#    ifndef OLED_RENDER_THREAD_PRIORITY
+#        define OLED_RENDER_THREAD_PRIORITY (NORMALPRIO + 1)
+#    endif
+#endif
+
+#if defined(OLED_TRANSPORT_SPI)
+#    if !defined(OLED_DC_PIN) || !defined(OLED_CS_PIN)
+#        error "OLED_TRANSPORT = spi requires OLED_DC_PIN and OLED_CS_PIN"
+#    endif
+#    if defined(PROTOCOL_CHIBIOS)
+// Define the spi your display is plugged to here
+#        ifndef OLED_SPI_DRIVER
+#            define OLED_SPI_DRIVER SPID1
+#        endif
+#        ifndef OLED_SPI_PAL_MODE
+#            define OLED_SPI_PAL_MODE 5
+#        endif
+// SPI_CR1 baudrate bits, fpclk / 8 by default
+#        ifndef OLED_SPI_BAUDRATE
+#            define OLED_SPI_BAUDRATE SPI_CR1_BR_1
+#        endif
+#        if !defined(OLED_SPI_SCK_PIN) || !defined(OLED_SPI_MOSI_PIN)
+#            error "OLED_TRANSPORT = spi requires OLED_SPI_SCK_PIN and OLED_SPI_MOSI_PIN on ChibiOS"
+#        endif
+#    elif defined(__AVR__)
+#        if defined(__AVR_AT90USB162__) || defined(__AVR_ATmega16U2__) || defined(__AVR_ATmega32U2__) || defined(__AVR_ATmega16U4__) || defined(__AVR_ATmega32U4__) || defined(__AVR_AT90USB646__) || defined(__AVR_AT90USB647__) || defined(__AVR_AT90USB1286__) || defined(__AVR_AT90USB1287__)
+#            define OLED_SPI_SS B0
+#            define OLED_SPI_SCK B1
+#            define OLED_SPI_MOSI B2
+#        elif defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328__)
+#            define OLED_SPI_SS B2
+#            define OLED_SPI_MOSI B3
+#            define OLED_SPI_SCK B5
+#        elif defined(__AVR_ATmega32A__)
+#            define OLED_SPI_SS B4
+#            define OLED_SPI_MOSI B5
+#            define OLED_SPI_SCK B7
+#        else
+#            error "OLED hardware SPI is not supported on this MCU"
+#        endif
+// SPI clock divisor, 2 gives 8 MHz on a 16 MHz MCU, within the 10 MHz the displays take
+#        ifndef OLED_SPI_DIVISOR
+#            define OLED_SPI_DIVISOR 2
+#        endif
+#        if OLED_SPI_DIVISOR == 2
+#            define OLED_SPCR 0
+#            define OLED_SPSR _BV(SPI2X)
+#        elif OLED_SPI_DIVISOR == 4
+#            define OLED_SPCR 0
+#            define OLED_SPSR 0
+#        elif OLED_SPI_DIVISOR == 8
+#            define OLED_SPCR _BV(SPR0)
+#            define OLED_SPSR _BV(SPI2X)
+#        elif OLED_SPI_DIVISOR == 16
+#            define OLED_SPCR _BV(SPR0)
+#            define OLED_SPSR 0
+#        else
+#            error "OLED_SPI_DIVISOR must be one of 2, 4, 8 or 16"
+#        endif
+#    endif
+#endif
+
 // Used commands from spec sheet: https://cdn-shop.adafruit.com/datasheets/SSD1306.pdf
 // for SH1106: https://www.velleman.eu/downloads/29/infosheets/sh1106_datasheet.pdf
+// for SSD1309: https://www.hpinfotech.ro/SSD1309.pdf
+// for SH1107: https://www.displayfuture.com/Display/datasheet/controller/SH1107.pdf
 
 // Fundamental Commands
 #define CONTRAST 0x81
@@ -54,6 +135,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 // Hardware Configuration Commands
 #define DISPLAY_START_LINE 0x40
+#define SH1107_DISPLAY_START_LINE 0xDC
 #define SEGMENT_REMAP 0xA0
 #define SEGMENT_REMAP_INV 0xA1
 #define MULTIPLEX_RATIO 0xA8
@@ -78,18 +160,33 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define OLED_BLOCK_COUNT (sizeof(OLED_BLOCK_TYPE) * 8)
 #define OLED_BLOCK_SIZE (OLED_MATRIX_SIZE / OLED_BLOCK_COUNT)
 
+// The SH1106 and SH1107 only have Page Addressing Mode
+#define OLED_PAGE_ADDRESSING (OLED_IC == OLED_IC_SH1106 || OLED_IC == OLED_IC_SH1107)
+
 // i2c defines
+// Command arrays start with the I2C_CMD control byte, which is skipped over SPI
 #define I2C_CMD 0x00
 #define I2C_DATA 0x40
-#if defined(__AVR__)
+#if defined(OLED_TRANSPORT_SPI)
+#    if defined(__AVR__)
+#        define OLED_TRANSMIT_P(data) oled_spi_send_P(&data[1], sizeof(data) - 1)
+#    else  // defined(__AVR__)
+#        define OLED_TRANSMIT_P(data) oled_spi_send(&data[1], sizeof(data) - 1, false)
+#    endif  // defined(__AVR__)
+#    define OLED_TRANSMIT(data) oled_spi_send(&data[1], sizeof(data) - 1, false)
+#else
+#    if defined(__AVR__)
 // already defined on ARM
-#    define I2C_TIMEOUT 100
-#    define I2C_TRANSMIT_P(data) i2c_transmit_P((OLED_DISPLAY_ADDRESS << 1), &data[0], sizeof(data), I2C_TIMEOUT)
-#else  // defined(__AVR__)
-#    define I2C_TRANSMIT_P(data) i2c_transmit((OLED_DISPLAY_ADDRESS << 1), &data[0], sizeof(data), I2C_TIMEOUT)
-#endif  // defined(__AVR__)
-#define I2C_TRANSMIT(data) i2c_transmit((OLED_DISPLAY_ADDRESS << 1), &data[0], sizeof(data), I2C_TIMEOUT)
-#define I2C_WRITE_REG(mode, data, size) i2c_writeReg((OLED_DISPLAY_ADDRESS << 1), mode, data, size, I2C_TIMEOUT)
+#        define I2C_TIMEOUT 100
+#        define I2C_TRANSMIT_P(data) i2c_transmit_P((OLED_DISPLAY_ADDRESS << 1), &data[0], sizeof(data), I2C_TIMEOUT)
+#    else  // defined(__AVR__)
+#        define I2C_TRANSMIT_P(data) i2c_transmit((OLED_DISPLAY_ADDRESS << 1), &data[0], sizeof(data), I2C_TIMEOUT)
+#    endif  // defined(__AVR__)
+#    define I2C_TRANSMIT(data) i2c_transmit((OLED_DISPLAY_ADDRESS << 1), &data[0], sizeof(data), I2C_TIMEOUT)
+#    define I2C_WRITE_REG(mode, data, size) i2c_writeReg((OLED_DISPLAY_ADDRESS << 1), mode, data, size, I2C_TIMEOUT)
+#    define OLED_TRANSMIT_P(data) (I2C_TRANSMIT_P(data) == I2C_STATUS_SUCCESS)
+#    define OLED_TRANSMIT(data) (I2C_TRANSMIT(data) == I2C_STATUS_SUCCESS)
+#endif
 
 #define HAS_FLAGS(bits, flags) ((bits & flags) == flags)
 
@@ -115,9 +212,107 @@ uint32_t oled_timeout;
 uint32_t oled_scroll_timeout;
 #endif
 
+#ifdef OLED_ASYNC_RENDER
+// The dirty blocks in display order, owned by the render thread while
+// oled_frame_dirty is non-zero. Rotation is done when a block is copied
+// in, so the thread sends straight from here. The first byte is spare,
+// see oled_send_data().
+static uint8_t                  oled_frame[1 + OLED_MATRIX_SIZE];
+static volatile OLED_BLOCK_TYPE oled_frame_dirty  = 0;
+static volatile OLED_BLOCK_TYPE oled_frame_failed = 0;
+static binary_semaphore_t       oled_render_request;
+static THD_WORKING_AREA(waOledRenderThread, 512);
+static bool oled_render_started = false;
+
+static void oled_render_start(void);
+#endif
+
 // Internal variables to reduce math instructions
 
-#if defined(__AVR__)
+#if defined(OLED_TRANSPORT_SPI)
+#    if defined(PROTOCOL_CHIBIOS)
+static SPIConfig oled_spi_cfg;
+#    endif
+
+static void oled_spi_init(void) {
+    setPinOutput(OLED_CS_PIN);
+    writePinHigh(OLED_CS_PIN);
+    setPinOutput(OLED_DC_PIN);
+
+#    if defined(PROTOCOL_CHIBIOS)
+#        if defined(USE_GPIOV1)
+    palSetLineMode(OLED_SPI_SCK_PIN, PAL_MODE_STM32_ALTERNATE_PUSHPULL);
+    palSetLineMode(OLED_SPI_MOSI_PIN, PAL_MODE_STM32_ALTERNATE_PUSHPULL);
+#        else
+    palSetLineMode(OLED_SPI_SCK_PIN, PAL_MODE_ALTERNATE(OLED_SPI_PAL_MODE) | PAL_STM32_OTYPE_PUSHPULL | PAL_STM32_OSPEED_HIGHEST);
+    palSetLineMode(OLED_SPI_MOSI_PIN, PAL_MODE_ALTERNATE(OLED_SPI_PAL_MODE) | PAL_STM32_OTYPE_PUSHPULL | PAL_STM32_OSPEED_HIGHEST);
+#        endif
+
+    // mode 0, MSB first, chip select driven by hand
+    oled_spi_cfg.cr1 = OLED_SPI_BAUDRATE;
+    spiStart(&OLED_SPI_DRIVER, &oled_spi_cfg);
+#    elif defined(__AVR__)
+    // SS has to stay high or be an output, or the SPI drops out of master mode
+    setPinOutput(OLED_SPI_SS);
+    setPinOutput(OLED_SPI_SCK);
+    setPinOutput(OLED_SPI_MOSI);
+
+    // master, mode 0, MSB first
+    SPCR = _BV(SPE) | _BV(MSTR) | OLED_SPCR;
+    SPSR = OLED_SPSR;
+#    endif
+
+#    if defined(OLED_RST_PIN)
+    // Displays wired for SPI usually need a reset pulse before they take commands
+    setPinOutput(OLED_RST_PIN);
+    writePinLow(OLED_RST_PIN);
+    wait_ms(1);
+    writePinHigh(OLED_RST_PIN);
+    wait_ms(1);
+#    endif
+}
+
+#    if defined(__AVR__)
+static inline void oled_spi_write(uint8_t byte) {
+    SPDR = byte;
+    while (!(SPSR & _BV(SPIF))) {
+    }
+}
+
+// identical to oled_spi_send, but for PROGMEM commands
+static bool oled_spi_send_P(const uint8_t *data, uint16_t size) {
+    writePinLow(OLED_DC_PIN);
+    writePinLow(OLED_CS_PIN);
+    for (uint16_t i = 0; i < size; i++) {
+        oled_spi_write(pgm_read_byte(data++));
+    }
+    writePinHigh(OLED_CS_PIN);
+    return true;
+}
+#    endif
+
+// Sends commands, or display data when is_data is set. SPI has no
+// acknowledge, so this cannot fail.
+static bool oled_spi_send(const uint8_t *data, uint16_t size, bool is_data) {
+#    if defined(PROTOCOL_CHIBIOS) && SPI_USE_MUTUAL_EXCLUSION
+    spiAcquireBus(&OLED_SPI_DRIVER);
+#    endif
+    writePin(OLED_DC_PIN, is_data);
+    writePinLow(OLED_CS_PIN);
+#    if defined(PROTOCOL_CHIBIOS)
+    spiSend(&OLED_SPI_DRIVER, size, data);
+#    elif defined(__AVR__)
+    for (uint16_t i = 0; i < size; i++) {
+        oled_spi_write(data[i]);
+    }
+#    endif
+    writePinHigh(OLED_CS_PIN);
+#    if defined(PROTOCOL_CHIBIOS) && SPI_USE_MUTUAL_EXCLUSION
+    spiReleaseBus(&OLED_SPI_DRIVER);
+#    endif
+    return true;
+}
+#elif defined(__AVR__)
 // identical to i2c_transmit, but for PROGMEM since all initialization is in PROGMEM arrays currently
 // probably should move this into i2c_master...
 static i2c_status_t i2c_transmit_P(uint8_t address, const uint8_t *data, uint16_t length, uint16_t timeout) {
@@ -150,7 +345,14 @@ bool oled_init(uint8_t rotation) {
     } else {
         oled_rotation_width = OLED_DISPLAY_HEIGHT;
     }
+#if defined(OLED_TRANSPORT_SPI)
+    oled_spi_init();
+#else
     i2c_init();
+#endif
+#ifdef OLED_ASYNC_RENDER
+    oled_render_start();
+#endif
 
     static const uint8_t PROGMEM display_setup1[] = {
         I2C_CMD,
@@ -161,36 +363,61 @@ bool oled_init(uint8_t rotation) {
         OLED_DISPLAY_HEIGHT - 1,
         DISPLAY_OFFSET,
         0x00,
+#if (OLED_IC == OLED_IC_SH1107)
+        SH1107_DISPLAY_START_LINE,
+        0x00,
+#else
         DISPLAY_START_LINE | 0x00,
+#endif
+#if (OLED_IC != OLED_IC_SSD1309)
+        // The SSD1309 runs from an external supply and has no charge pump
         CHARGE_PUMP,
         0x14,
-#if (OLED_IC != OLED_IC_SH1106)
-        // MEMORY_MODE is unsupported on SH1106 (Page Addressing only)
+#endif
+#if !OLED_PAGE_ADDRESSING
+        // MEMORY_MODE is unsupported on SH1106 and SH1107 (Page Addressing only)
         MEMORY_MODE,
         0x00,  // Horizontal addressing mode
 #endif
     };
-    if (I2C_TRANSMIT_P(display_setup1) != I2C_STATUS_SUCCESS) {
+    if (!OLED_TRANSMIT_P(display_setup1)) {
         print("oled_init cmd set 1 failed\n");
         return false;
     }
 
     if (!HAS_FLAGS(oled_rotation, OLED_ROTATION_180)) {
         static const uint8_t PROGMEM display_normal[] = {I2C_CMD, SEGMENT_REMAP_INV, COM_SCAN_DEC};
-        if (I2C_TRANSMIT_P(display_normal) != I2C_STATUS_SUCCESS) {
+        if (!OLED_TRANSMIT_P(display_normal)) {
             print("oled_init cmd normal rotation failed\n");
             return false;
         }
     } else {
         static const uint8_t PROGMEM display_flipped[] = {I2C_CMD, SEGMENT_REMAP, COM_SCAN_INC};
-        if (I2C_TRANSMIT_P(display_flipped) != I2C_STATUS_SUCCESS) {
+        if (!OLED_TRANSMIT_P(display_flipped)) {
             print("display_flipped failed\n");
             return false;
         }
     }
 
-    static const uint8_t PROGMEM display_setup2[] = {I2C_CMD, COM_PINS, OLED_COM_PINS, CONTRAST, 0x8F, PRE_CHARGE_PERIOD, 0xF1, VCOM_DETECT, 0x40, DISPLAY_ALL_ON_RESUME, NORMAL_DISPLAY, DEACTIVATE_SCROLL, DISPLAY_ON};
-    if (I2C_TRANSMIT_P(display_setup2) != I2C_STATUS_SUCCESS) {
+    static const uint8_t PROGMEM display_setup2[] = {
+        I2C_CMD,
+#if (OLED_IC != OLED_IC_SH1107)
+        // The SH1107 has no COM pins configuration
+        COM_PINS,
+        OLED_COM_PINS,
+#endif
+        CONTRAST,
+        0x8F,
+        PRE_CHARGE_PERIOD,
+        0xF1,
+        VCOM_DETECT,
+        0x40,
+        DISPLAY_ALL_ON_RESUME,
+        NORMAL_DISPLAY,
+        DEACTIVATE_SCROLL,
+        DISPLAY_ON,
+    };
+    if (!OLED_TRANSMIT_P(display_setup2)) {
         print("display_setup2 failed\n");
         return false;
     }
@@ -217,97 +444,282 @@ void oled_clear(void) {
     oled_dirty  = -1;  // -1 will be max value as long as display_dirty is unsigned type
 }
 
-static void calc_bounds(uint8_t update_start, uint8_t *cmd_array) {
-    // Calculate commands to set memory addressing bounds.
-    uint8_t start_page   = OLED_BLOCK_SIZE * update_start / OLED_DISPLAY_WIDTH;
-    uint8_t start_column = OLED_BLOCK_SIZE * update_start % OLED_DISPLAY_WIDTH;
-#if (OLED_IC == OLED_IC_SH1106)
+// Number of dirty blocks from update_start, up to max, that can be sent in
+// one transfer. The display only wraps from the end of one page to the
+// start of the next, so a burst that starts mid page ends with the page.
+static uint8_t burst_length(OLED_BLOCK_TYPE dirty, uint8_t update_start, uint8_t max) {
+    uint16_t start = OLED_BLOCK_SIZE * update_start;
+    uint8_t  count = 1;
+    while (count < max && update_start + count < OLED_BLOCK_COUNT && (dirty & ((OLED_BLOCK_TYPE)1 << (update_start + count)))) {
+        uint16_t end = start + OLED_BLOCK_SIZE * (count + 1);
+#if OLED_PAGE_ADDRESSING
+        // Page Addressing Mode never leaves the page
+        if ((end - 1) / OLED_DISPLAY_WIDTH != start / OLED_DISPLAY_WIDTH) break;
+#else
+        if (start % OLED_DISPLAY_WIDTH && end > start - start % OLED_DISPLAY_WIDTH + OLED_DISPLAY_WIDTH) break;
+#endif
+        count++;
+    }
+    return count;
+}
+
+#if OLED_PAGE_ADDRESSING
+static void calc_page_bounds(uint8_t page, uint8_t column, uint8_t *cmd_array) {
     // Commands for Page Addressing Mode. Sets starting page and column; has no end bound.
     // Column value must be split into high and low nybble and sent as two commands.
-    cmd_array[0] = PAM_PAGE_ADDR | start_page;
-    cmd_array[1] = PAM_SETCOLUMN_LSB | ((OLED_COLUMN_OFFSET + start_column) & 0x0f);
-    cmd_array[2] = PAM_SETCOLUMN_MSB | ((OLED_COLUMN_OFFSET + start_column) >> 4 & 0x0f);
+    cmd_array[0] = PAM_PAGE_ADDR | page;
+    cmd_array[1] = PAM_SETCOLUMN_LSB | ((OLED_COLUMN_OFFSET + column) & 0x0f);
+    cmd_array[2] = PAM_SETCOLUMN_MSB | ((OLED_COLUMN_OFFSET + column) >> 4 & 0x0f);
     cmd_array[3] = NOP;
     cmd_array[4] = NOP;
     cmd_array[5] = NOP;
+}
+#endif
+
+static void calc_bounds(uint8_t update_start, uint8_t count, uint8_t *cmd_array) {
+    // Calculate commands to set memory addressing bounds.
+    uint16_t start        = OLED_BLOCK_SIZE * update_start;
+    uint16_t length       = OLED_BLOCK_SIZE * count;
+    uint8_t  start_page   = start / OLED_DISPLAY_WIDTH;
+    uint8_t  start_column = start % OLED_DISPLAY_WIDTH;
+#if OLED_PAGE_ADDRESSING
+    (void)length;
+    calc_page_bounds(start_page, start_column, cmd_array);
 #else
     // Commands for use in Horizontal Addressing mode.
     cmd_array[1] = start_column;
     cmd_array[4] = start_page;
-    cmd_array[2] = (OLED_BLOCK_SIZE + OLED_DISPLAY_WIDTH - 1) % OLED_DISPLAY_WIDTH + cmd_array[1];
-    cmd_array[5] = (OLED_BLOCK_SIZE + OLED_DISPLAY_WIDTH - 1) / OLED_DISPLAY_WIDTH - 1;
+    cmd_array[2] = start_column + length > OLED_DISPLAY_WIDTH ? OLED_DISPLAY_WIDTH - 1 : start_column + length - 1;
+    cmd_array[5] = (start + length - 1) / OLED_DISPLAY_WIDTH;
 #endif
 }
 
+// A rotated block covers the full height of ROTATED_COLUMNS display
+// columns, or ROTATED_PAGES pages of 8 columns if it is smaller than that
+#define ROTATED_PAGES (OLED_BLOCK_SIZE >= OLED_DISPLAY_HEIGHT ? OLED_DISPLAY_HEIGHT / 8 : OLED_BLOCK_SIZE / 8)
+#define ROTATED_COLUMNS (OLED_BLOCK_SIZE / ROTATED_PAGES)
+
 static void calc_bounds_90(uint8_t update_start, uint8_t *cmd_array) {
-    cmd_array[1] = OLED_BLOCK_SIZE * update_start / OLED_DISPLAY_HEIGHT * 8;
-    cmd_array[4] = OLED_BLOCK_SIZE * update_start % OLED_DISPLAY_HEIGHT;
-    cmd_array[2] = (OLED_BLOCK_SIZE + OLED_DISPLAY_HEIGHT - 1) / OLED_DISPLAY_HEIGHT * 8 - 1 + cmd_array[1];
-    ;
-    cmd_array[5] = (OLED_BLOCK_SIZE + OLED_DISPLAY_HEIGHT - 1) % OLED_DISPLAY_HEIGHT / 8;
+    // Our memory runs from the bottom of the display up in this mode
+    uint16_t start        = OLED_BLOCK_SIZE * update_start;
+    uint8_t  start_page   = OLED_DISPLAY_HEIGHT / 8 - ROTATED_PAGES - start % OLED_DISPLAY_HEIGHT / 8;
+    uint8_t  start_column = start / OLED_DISPLAY_HEIGHT * 8;
+#if OLED_PAGE_ADDRESSING
+    // Only the first page, see oled_send_blocks()
+    calc_page_bounds(start_page, start_column, cmd_array);
+#else
+    cmd_array[1] = start_column;
+    cmd_array[4] = start_page;
+    cmd_array[2] = start_column + ROTATED_COLUMNS - 1;
+    cmd_array[5] = start_page + ROTATED_PAGES - 1;
+#endif
 }
 
-uint8_t crot(uint8_t a, int8_t n) {
-    const uint8_t mask = 0x7;
-    n &= mask;
-    return a << n | a >> (-n & mask);
-}
+// Spreads the 4 bits of n over the lowest bit of 4 bytes, see rotate_90()
+#define SPREAD_NIBBLE(n) ((((n)&1) ? 0x00000001UL : 0) | (((n)&2) ? 0x00000100UL : 0) | (((n)&4) ? 0x00010000UL : 0) | (((n)&8) ? 0x01000000UL : 0))
 
+static const uint32_t PROGMEM spread_nibble[16] = {
+    SPREAD_NIBBLE(0), SPREAD_NIBBLE(1), SPREAD_NIBBLE(2),  SPREAD_NIBBLE(3),  SPREAD_NIBBLE(4),  SPREAD_NIBBLE(5),  SPREAD_NIBBLE(6),  SPREAD_NIBBLE(7),
+    SPREAD_NIBBLE(8), SPREAD_NIBBLE(9), SPREAD_NIBBLE(10), SPREAD_NIBBLE(11), SPREAD_NIBBLE(12), SPREAD_NIBBLE(13), SPREAD_NIBBLE(14), SPREAD_NIBBLE(15),
+};
+
+// Transposes an 8x8 pixel tile, bit i of src[j] becomes bit 7 - j of dest[i].
+// Each source byte is spread over the destination bytes with two table
+// lookups, instead of rotating every bit into place.
 static void rotate_90(const uint8_t *src, uint8_t *dest) {
-    for (uint8_t i = 0, shift = 7; i < 8; ++i, --shift) {
-        uint8_t selector = (1 << i);
-        for (uint8_t j = 0; j < 8; ++j) {
-            dest[i] |= crot(src[j] & selector, shift - (int8_t)j);
-        }
+    uint32_t low  = 0;
+    uint32_t high = 0;
+    for (uint8_t j = 0; j < 8; ++j) {
+        low |= pgm_read_dword(&spread_nibble[src[j] & 0x0F]) << (7 - j);
+        high |= pgm_read_dword(&spread_nibble[src[j] >> 4]) << (7 - j);
+    }
+    for (uint8_t i = 0; i < 4; ++i) {
+        dest[i] |= low >> (8 * i);
+        dest[i + 4] |= high >> (8 * i);
     }
 }
 
-void oled_render(void) {
-    // Do we have work to do?
-    if (!oled_dirty || oled_scrolling) {
-        return;
-    }
+// Rotates a block of oled_buffer into the order the display expects it in
+static void rotate_block(uint8_t update_start, uint8_t *dest) {
+    const uint8_t *src = &oled_buffer[OLED_BLOCK_SIZE * update_start];
 
-    // Find first dirty block
-    uint8_t update_start = 0;
-    while (!(oled_dirty & (1 << update_start))) {
-        ++update_start;
+    memset(dest, 0, OLED_BLOCK_SIZE);
+#if defined(OLED_SOURCE_MAP)
+    // For 90 degree rotation, we map our internal matrix to oled matrix using fixed arrays
+    const static uint8_t source_map[] = OLED_SOURCE_MAP;
+    const static uint8_t target_map[] = OLED_TARGET_MAP;
+
+    for (uint8_t i = 0; i < sizeof(source_map); ++i) {
+        rotate_90(&src[source_map[i]], &dest[target_map[i]]);
+    }
+#else
+    // The display takes the block a page at a time, top to bottom, while
+    // each line of our memory runs bottom to top, 8 display columns wide.
+    for (uint16_t i = 0; i < OLED_BLOCK_SIZE; i += 8) {
+        uint8_t page = ROTATED_PAGES - 1 - i % OLED_DISPLAY_HEIGHT / 8;
+        rotate_90(&src[i], &dest[page * ROTATED_COLUMNS + i / OLED_DISPLAY_HEIGHT * 8]);
     }
+#endif
+}
 
+static bool oled_send_data(uint8_t *data, uint16_t size) {
+#if defined(OLED_TRANSPORT_SPI)
+    return oled_spi_send(data, size, true);
+#elif defined(OLED_ASYNC_RENDER)
+    // The byte in front of the data is borrowed for the control byte, so
+    // the burst goes out straight from oled_frame without another copy.
+    uint8_t borrowed = data[-1];
+    data[-1]         = I2C_DATA;
+
+    i2c_status_t status = i2c_transmit((OLED_DISPLAY_ADDRESS << 1), data - 1, size + 1, I2C_TIMEOUT);
+    data[-1]            = borrowed;
+    return status == I2C_STATUS_SUCCESS;
+#else
+    return I2C_WRITE_REG(I2C_DATA, data, size) == I2C_STATUS_SUCCESS;
+#endif
+}
+
+// Sends count blocks from update_start, already in display order
+static bool oled_send_blocks(uint8_t update_start, uint8_t count, uint8_t *data) {
     // Set column & page position
     static uint8_t display_start[] = {I2C_CMD, COLUMN_ADDR, 0, OLED_DISPLAY_WIDTH - 1, PAGE_ADDR, 0, OLED_DISPLAY_HEIGHT / 8 - 1};
+    uint8_t        pages           = 1;
+    uint16_t       length          = OLED_BLOCK_SIZE * count;
     if (!HAS_FLAGS(oled_rotation, OLED_ROTATION_90)) {
-        calc_bounds(update_start, &display_start[1]);  // Offset from I2C_CMD byte at the start
+        calc_bounds(update_start, count, &display_start[1]);  // Offset from I2C_CMD byte at the start
     } else {
         calc_bounds_90(update_start, &display_start[1]);  // Offset from I2C_CMD byte at the start
+#if OLED_PAGE_ADDRESSING
+        // Page Addressing Mode never leaves the page, so a rotated block is sent a page at a time
+        pages  = ROTATED_PAGES;
+        length = ROTATED_COLUMNS;
+#endif
+    }
+
+    for (uint8_t page = 0; page < pages; page++) {
+        // Send column & page position
+        if (!OLED_TRANSMIT(display_start)) {
+            print("oled_render offset command failed\n");
+            return false;
+        }
+
+        // Send render data
+        if (!oled_send_data(&data[length * page], length)) {
+            print("oled_render data failed\n");
+            return false;
+        }
+#if OLED_PAGE_ADDRESSING
+        display_start[1]++;  // PAM_PAGE_ADDR of the next page
+#endif
+    }
+    return true;
+}
+
+static uint8_t first_dirty_block(OLED_BLOCK_TYPE dirty) {
+    uint8_t update_start = 0;
+    while (!(dirty & ((OLED_BLOCK_TYPE)1 << update_start))) {
+        ++update_start;
+    }
+    return update_start;
+}
+
+// Blocks update_start to update_start + count - 1 of a dirty bitmask,
+// shifting by the full width of OLED_BLOCK_TYPE is undefined so that run is special cased
+#define BLOCK_RUN(update_start, count) ((OLED_BLOCK_TYPE)(((count) >= sizeof(OLED_BLOCK_TYPE) * 8 ? (OLED_BLOCK_TYPE)~(OLED_BLOCK_TYPE)0 : (((OLED_BLOCK_TYPE)1 << (count)) - 1)) << (update_start)))
+
+#ifdef OLED_ASYNC_RENDER
+static THD_FUNCTION(oled_render_thread, arg) {
+    (void)arg;
+    chRegSetThreadName("oled_render");
+
+    while (true) {
+        chBSemWait(&oled_render_request);
+
+        OLED_BLOCK_TYPE dirty = oled_frame_dirty;
+        while (dirty) {
+            uint8_t update_start = first_dirty_block(dirty);
+            uint8_t count        = HAS_FLAGS(oled_rotation, OLED_ROTATION_90) ? 1 : burst_length(dirty, update_start, OLED_BLOCK_COUNT);
+            if (!oled_send_blocks(update_start, count, &oled_frame[1 + OLED_BLOCK_SIZE * update_start])) {
+                break;
+            }
+            dirty &= ~BLOCK_RUN(update_start, count);
+        }
+
+        // Hand the frame back, along with any blocks that failed
+        chSysLock();
+        oled_frame_failed |= dirty;
+        oled_frame_dirty = 0;
+        chSysUnlock();
+    }
+}
+
+static void oled_render_start(void) {
+    if (!oled_render_started) {
+        chBSemObjectInit(&oled_render_request, true);
+        chThdCreateStatic(waOledRenderThread, sizeof(waOledRenderThread), OLED_RENDER_THREAD_PRIORITY, oled_render_thread, NULL);
+        oled_render_started = true;
     }
+}
+
+static bool oled_render_busy(void) { return oled_frame_dirty != 0; }
 
-    // Send column & page position
-    if (I2C_TRANSMIT(display_start) != I2C_STATUS_SUCCESS) {
-        print("oled_render offset command failed\n");
+void oled_render(void) {
+    // The previous frame is still being sent, keep the changes for the next one
+    if (oled_render_busy()) {
         return;
     }
 
+    oled_dirty |= oled_frame_failed;
+    oled_frame_failed = 0;
+
+    // Do we have work to do?
+    if (!oled_dirty || oled_scrolling) {
+        return;
+    }
+
+    // Copy the dirty blocks over, rotating them on the way if needed
+    for (uint8_t update_start = 0; update_start < OLED_BLOCK_COUNT; update_start++) {
+        if (oled_dirty & ((OLED_BLOCK_TYPE)1 << update_start)) {
+            uint8_t *dest = &oled_frame[1 + OLED_BLOCK_SIZE * update_start];
+            if (!HAS_FLAGS(oled_rotation, OLED_ROTATION_90)) {
+                memcpy(dest, &oled_buffer[OLED_BLOCK_SIZE * update_start], OLED_BLOCK_SIZE);
+            } else {
+                rotate_block(update_start, dest);
+            }
+        }
+    }
+
+    // Turn on display if it is off
+    oled_on();
+
+    oled_frame_dirty = oled_dirty;
+    oled_dirty       = 0;
+    chBSemSignal(&oled_render_request);
+}
+#else
+static bool oled_render_busy(void) { return false; }
+
+void oled_render(void) {
+    // Do we have work to do?
+    if (!oled_dirty || oled_scrolling) {
+        return;
+    }
+
+    // Find first dirty block
+    uint8_t update_start = first_dirty_block(oled_dirty);
+    uint8_t count        = 1;
+
     if (!HAS_FLAGS(oled_rotation, OLED_ROTATION_90)) {
-        // Send render data chunk as is
-        if (I2C_WRITE_REG(I2C_DATA, &oled_buffer[OLED_BLOCK_SIZE * update_start], OLED_BLOCK_SIZE) != I2C_STATUS_SUCCESS) {
-            print("oled_render data failed\n");
+        // Send render data as is, along with the dirty blocks right after it
+        count = burst_length(oled_dirty, update_start, OLED_RENDER_BLOCKS);
+        if (!oled_send_blocks(update_start, count, &oled_buffer[OLED_BLOCK_SIZE * update_start])) {
             return;
         }
     } else {
-        // Rotate the render chunks
-        const static uint8_t source_map[] = OLED_SOURCE_MAP;
-        const static uint8_t target_map[] = OLED_TARGET_MAP;
-
+        // Rotate the render chunk
         static uint8_t temp_buffer[OLED_BLOCK_SIZE];
-        memset(temp_buffer, 0, sizeof(temp_buffer));
-        for (uint8_t i = 0; i < sizeof(source_map); ++i) {
-            rotate_90(&oled_buffer[OLED_BLOCK_SIZE * update_start + source_map[i]], &temp_buffer[target_map[i]]);
-        }
-
-        // Send render data chunk after rotating
-        if (I2C_WRITE_REG(I2C_DATA, &temp_buffer[0], OLED_BLOCK_SIZE) != I2C_STATUS_SUCCESS) {
-            print("oled_render90 data failed\n");
+        rotate_block(update_start, temp_buffer);
+        if (!oled_send_blocks(update_start, 1, temp_buffer)) {
             return;
         }
     }
@@ -316,8 +728,9 @@ void oled_render(void) {
     oled_on();
 
     // Clear dirty flag
-    oled_dirty &= ~(1 << update_start);
+    oled_dirty &= ~BLOCK_RUN(update_start, count);
 }
+#endif
 
 void oled_set_cursor(uint8_t col, uint8_t line) {
     uint16_t index = line * oled_rotation_width + col * OLED_FONT_WIDTH;
@@ -406,9 +819,9 @@ void oled_write_char(const char data, bool invert) {
     // Dirty check
     if (memcmp(&oled_temp_buffer, oled_cursor, OLED_FONT_WIDTH)) {
         uint16_t index = oled_cursor - &oled_buffer[0];
-        oled_dirty |= (1 << (index / OLED_BLOCK_SIZE));
+        oled_dirty |= ((OLED_BLOCK_TYPE)1 << (index / OLED_BLOCK_SIZE));
         // Edgecase check if the written data spans the 2 chunks
-        oled_dirty |= (1 << ((index + OLED_FONT_WIDTH) / OLED_BLOCK_SIZE));
+        oled_dirty |= ((OLED_BLOCK_TYPE)1 << ((index + OLED_FONT_WIDTH) / OLED_BLOCK_SIZE));
     }
 
     // Finally move to the next char
@@ -450,7 +863,7 @@ void oled_write_raw_byte(const char data, uint16_t index) {
     if (index > OLED_MATRIX_SIZE) index = OLED_MATRIX_SIZE;
     if (oled_buffer[index] == data) return;
     oled_buffer[index] = data;
-    oled_dirty |= (1 << (index / OLED_BLOCK_SIZE));
+    oled_dirty |= ((OLED_BLOCK_TYPE)1 << (index / OLED_BLOCK_SIZE));
 }
 
 void oled_write_raw(const char *data, uint16_t size) {
@@ -458,7 +871,7 @@ void oled_write_raw(const char *data, uint16_t size) {
     for (uint16_t i = 0; i < size; i++) {
         if (oled_buffer[i] == data[i]) continue;
         oled_buffer[i] = data[i];
-        oled_dirty |= (1 << (i / OLED_BLOCK_SIZE));
+        oled_dirty |= ((OLED_BLOCK_TYPE)1 << (i / OLED_BLOCK_SIZE));
     }
 }
 
@@ -482,7 +895,7 @@ void oled_write_raw_P(const char *data, uint16_t size) {
         uint8_t c = pgm_read_byte(++data);
         if (oled_buffer[i] == c) continue;
         oled_buffer[i] = c;
-        oled_dirty |= (1 << (i / OLED_BLOCK_SIZE));
+        oled_dirty |= ((OLED_BLOCK_TYPE)1 << (i / OLED_BLOCK_SIZE));
     }
 }
 #endif  // defined(__AVR__)
@@ -494,7 +907,7 @@ bool oled_on(void) {
 
     static const uint8_t PROGMEM display_on[] = {I2C_CMD, DISPLAY_ON};
     if (!oled_active) {
-        if (I2C_TRANSMIT_P(display_on) != I2C_STATUS_SUCCESS) {
+        if (!OLED_TRANSMIT_P(display_on)) {
             print("oled_on cmd failed\n");
             return oled_active;
         }
@@ -506,7 +919,7 @@ bool oled_on(void) {
 bool oled_off(void) {
     static const uint8_t PROGMEM display_off[] = {I2C_CMD, DISPLAY_OFF};
     if (oled_active) {
-        if (I2C_TRANSMIT_P(display_off) != I2C_STATUS_SUCCESS) {
+        if (!OLED_TRANSMIT_P(display_off)) {
             print("oled_off cmd failed\n");
             return oled_active;
         }
@@ -543,9 +956,9 @@ void oled_scroll_set_speed(uint8_t speed) {
 bool oled_scroll_right(void) {
     // Dont enable scrolling if we need to update the display
     // This prevents scrolling of bad data from starting the scroll too early after init
-    if (!oled_dirty && !oled_scrolling) {
+    if (!oled_dirty && !oled_render_busy() && !oled_scrolling) {
         uint8_t display_scroll_right[] = {I2C_CMD, SCROLL_RIGHT, 0x00, oled_scroll_start, oled_scroll_speed, oled_scroll_end, 0x00, 0xFF, ACTIVATE_SCROLL};
-        if (I2C_TRANSMIT(display_scroll_right) != I2C_STATUS_SUCCESS) {
+        if (!OLED_TRANSMIT(display_scroll_right)) {
             print("oled_scroll_right cmd failed\n");
             return oled_scrolling;
         }
@@ -557,9 +970,9 @@ bool oled_scroll_right(void) {
 bool oled_scroll_left(void) {
     // Dont enable scrolling if we need to update the display
     // This prevents scrolling of bad data from starting the scroll too early after init
-    if (!oled_dirty && !oled_scrolling) {
+    if (!oled_dirty && !oled_render_busy() && !oled_scrolling) {
         uint8_t display_scroll_left[] = {I2C_CMD, SCROLL_LEFT, 0x00, oled_scroll_start, oled_scroll_speed, oled_scroll_end, 0x00, 0xFF, ACTIVATE_SCROLL};
-        if (I2C_TRANSMIT(display_scroll_left) != I2C_STATUS_SUCCESS) {
+        if (!OLED_TRANSMIT(display_scroll_left)) {
             print("oled_scroll_left cmd failed\n");
             return oled_scrolling;
         }
@@ -571,7 +984,7 @@ bool oled_scroll_left(void) {
 bool oled_scroll_off(void) {
     if (oled_scrolling) {
         static const uint8_t PROGMEM display_scroll_off[] = {I2C_CMD, DEACTIVATE_SCROLL};
-        if (I2C_TRANSMIT_P(display_scroll_off) != I2C_STATUS_SUCCESS) {
+        if (!OLED_TRANSMIT_P(display_scroll_off)) {
             print("oled_scroll_off cmd failed\n");
             return oled_scrolling;
         }
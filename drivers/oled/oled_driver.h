@@ -22,6 +22,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 // an enumeration of the chips this driver supports
 #define OLED_IC_SSD1306 0
 #define OLED_IC_SH1106 1
+#define OLED_IC_SSD1309 2
+#define OLED_IC_SH1107 3
 
 #if defined(OLED_DISPLAY_CUSTOM)
 // Expected user to implement the necessary defines
@@ -48,26 +50,32 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #    ifndef OLED_COM_PINS
 #        define OLED_COM_PINS COM_PINS_ALT
 #    endif
-
-// For 90 degree rotation, we map our internal matrix to oled matrix using fixed arrays
-// The OLED writes to it's memory horizontally, starting top left, but our memory starts bottom left in this mode
-#    ifndef OLED_SOURCE_MAP
-#        define OLED_SOURCE_MAP \
-            { 0, 8, 16, 24, 32, 40, 48, 56 }
+#elif defined(OLED_DISPLAY_128X128)
+// Quad height 128x128, as driven by the SH1107
+#    ifndef OLED_DISPLAY_WIDTH
+#        define OLED_DISPLAY_WIDTH 128
 #    endif
-#    ifndef OLED_TARGET_MAP
-#        define OLED_TARGET_MAP \
-            { 56, 48, 40, 32, 24, 16, 8, 0 }
+#    ifndef OLED_DISPLAY_HEIGHT
+#        define OLED_DISPLAY_HEIGHT 128
+#    endif
+#    ifndef OLED_MATRIX_SIZE
+#        define OLED_MATRIX_SIZE (OLED_DISPLAY_HEIGHT / 8 * OLED_DISPLAY_WIDTH)  // 2048 (compile time mathed)
+#    endif
+#    ifndef OLED_BLOCK_TYPE
+#        define OLED_BLOCK_TYPE uint64_t
+#    endif
+#    ifndef OLED_BLOCK_COUNT
+#        define OLED_BLOCK_COUNT (sizeof(OLED_BLOCK_TYPE) * 8)  // 64 (compile time mathed)
+#    endif
+#    ifndef OLED_BLOCK_SIZE
+#        define OLED_BLOCK_SIZE (OLED_MATRIX_SIZE / OLED_BLOCK_COUNT)  // 32 (compile time mathed)
+#    endif
+#    ifndef OLED_COM_PINS
+#        define OLED_COM_PINS COM_PINS_ALT
+#    endif
+#    ifndef OLED_IC
+#        define OLED_IC OLED_IC_SH1107
 #    endif
-// If OLED_BLOCK_TYPE is uint32_t, these tables would look like:
-// #define OLED_SOURCE_MAP { 32, 40, 48, 56 }
-// #define OLED_TARGET_MAP { 24, 16, 8, 0 }
-// If OLED_BLOCK_TYPE is uint16_t, these tables would look like:
-// #define OLED_SOURCE_MAP { 0, 8, 16, 24, 32, 40, 48, 56 }
-// #define OLED_TARGET_MAP { 56, 48, 40, 32, 24, 16, 8, 0 }
-// If OLED_BLOCK_TYPE is uint8_t, these tables would look like:
-// #define OLED_SOURCE_MAP { 0, 8, 16, 24, 32, 40, 48, 56, 64, 72, 80, 88, 96, 104, 112, 120 }
-// #define OLED_TARGET_MAP { 56, 120, 48, 112, 40, 104, 32, 96, 24, 88, 16, 80, 8, 72, 0, 64 }
 #else  // defined(OLED_DISPLAY_128X64)
 // Default 128x32
 #    ifndef OLED_DISPLAY_WIDTH
@@ -91,21 +99,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #    ifndef OLED_COM_PINS
 #        define OLED_COM_PINS COM_PINS_SEQ
 #    endif
+#endif  // defined(OLED_DISPLAY_CUSTOM)
 
-// For 90 degree rotation, we map our internal matrix to oled matrix using fixed arrays
-// The OLED writes to it's memory horizontally, starting top left, but our memory starts bottom left in this mode
-#    ifndef OLED_SOURCE_MAP
-#        define OLED_SOURCE_MAP \
-            { 0, 8, 16, 24 }
-#    endif
-#    ifndef OLED_TARGET_MAP
-#        define OLED_TARGET_MAP \
-            { 24, 16, 8, 0 }
-#    endif
-// If OLED_BLOCK_TYPE is uint8_t, these tables would look like:
+// For 90 degree rotation, blocks of our internal matrix are mapped to the
+// oled matrix from the display height and block size. A custom mapping can
+// still be given with OLED_SOURCE_MAP and OLED_TARGET_MAP, e.g. for 128x32
+// with OLED_BLOCK_TYPE uint8_t:
 // #define OLED_SOURCE_MAP { 0, 8, 16, 24, 32, 40, 48, 56 }
 // #define OLED_TARGET_MAP { 48, 32, 16, 0, 56, 40, 24, 8 }
-#endif  // defined(OLED_DISPLAY_CUSTOM)
 
 #if !defined(OLED_IC)
 #    define OLED_IC OLED_IC_SSD1306
@@ -121,6 +122,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #    define OLED_DISPLAY_ADDRESS 0x3C
 #endif
 
+// With OLED_TRANSPORT = spi, the data/command pin and chip select pin
+// the display is wired to. OLED_RST_PIN is optional.
+// #define OLED_DC_PIN B4
+// #define OLED_CS_PIN B6
+// #define OLED_RST_PIN B5
+
 // Custom font file to use
 #if !defined(OLED_FONT_H)
 #    define OLED_FONT_H "glcdfont.c"
@@ -150,6 +157,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #    endif
 #endif
 
+// Most dirty blocks a call to oled_render() sends, in one transfer where
+// the display memory allows it. More blocks need fewer calls to clear the
+// buffer but each call takes longer. With OLED_ASYNC_RENDER every dirty
+// block is handed to the render thread at once.
+#if !defined(OLED_RENDER_BLOCKS)
+#    define OLED_RENDER_BLOCKS 1
+#endif
+
 // OLED Rotation enum values are flags
 typedef enum {
     OLED_ROTATION_0   = 0,
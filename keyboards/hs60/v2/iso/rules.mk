@@ -29,5 +29,6 @@ LAYOUTS = 60_iso
 SRC =	keyboards/wilba_tech/wt_main.c \
 		keyboards/wilba_tech/wt_rgb_backlight.c \
 		drivers/issi/is31fl3733.c \
+		drivers/issi/issi_flush.c \
 		quantum/color.c \
 		drivers/chibios/i2c_master.c
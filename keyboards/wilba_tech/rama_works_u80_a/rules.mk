@@ -36,4 +36,5 @@ SRC =	keyboards/wilba_tech/wt_main.c \
 		keyboards/wilba_tech/wt_rgb_backlight.c \
 		quantum/color.c \
 		drivers/issi/is31fl3731.c \
+		drivers/issi/issi_flush.c \
 		drivers/avr/i2c_master.c
@@ -44,6 +44,7 @@ SRC +=	keyboards/wilba_tech/wt_main.c \
 		keyboards/wilba_tech/wt_rgb_backlight.c \
 		quantum/color.c \
 		drivers/issi/is31fl3731.c \
+		drivers/issi/issi_flush.c \
 		ws2812.c
 
 QUANTUM_LIB_SRC += i2c_master.c 
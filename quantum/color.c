@@ -18,22 +18,18 @@
 #include "led_tables.h"
 #include "progmem.h"
 
-RGB hsv_to_rgb(HSV hsv) {
+// Which of v, q, p and t feeds the red, green and blue channel for each of
+// the hue regions (region 6 is h == 255 and wraps around to red)
+enum { HSV_V, HSV_Q, HSV_P, HSV_T };
+static const uint8_t hsv_sectors[7][3] PROGMEM = {
+    {HSV_V, HSV_T, HSV_P}, {HSV_Q, HSV_V, HSV_P}, {HSV_P, HSV_V, HSV_T}, {HSV_P, HSV_Q, HSV_V}, {HSV_T, HSV_P, HSV_V}, {HSV_V, HSV_P, HSV_Q}, {HSV_V, HSV_T, HSV_P},
+};
+
+static inline RGB hsv_to_rgb_impl(HSV hsv) {
     RGB      rgb;
-    uint8_t  region, remainder, p, q, t;
+    uint8_t  region, remainder, c[4];
     uint16_t h, s, v;
 
-    if (hsv.s == 0) {
-#ifdef USE_CIE1931_CURVE
-        rgb.r = rgb.g = rgb.b = pgm_read_byte(&CIE1931_CURVE[hsv.v]);
-#else
-        rgb.r = hsv.v;
-        rgb.g = hsv.v;
-        rgb.b = hsv.v;
-#endif
-        return rgb;
-    }
-
     h = hsv.h;
     s = hsv.s;
 #ifdef USE_CIE1931_CURVE
@@ -42,50 +38,38 @@ RGB hsv_to_rgb(HSV hsv) {
     v = hsv.v;
 #endif
 
-    region    = h * 6 / 255;
-    remainder = (h * 2 - region * 85) * 3;
+    if (s == 0) {
+        rgb.r = rgb.g = rgb.b = v;
+        return rgb;
+    }
 
-    p = (v * (255 - s)) >> 8;
-    q = (v * (255 - ((s * remainder) >> 8))) >> 8;
-    t = (v * (255 - ((s * (255 - remainder)) >> 8))) >> 8;
+    // h * 6 / 255 without the division, exact for h * 6 < 65535
+    uint16_t sector = h * 6;
+    region          = (sector + 1 + (sector >> 8)) >> 8;
+    remainder       = (h * 2 - region * 85) * 3;
 
-    switch (region) {
-        case 6:
-        case 0:
-            rgb.r = v;
-            rgb.g = t;
-            rgb.b = p;
-            break;
-        case 1:
-            rgb.r = q;
-            rgb.g = v;
-            rgb.b = p;
-            break;
-        case 2:
-            rgb.r = p;
-            rgb.g = v;
-            rgb.b = t;
-            break;
-        case 3:
-            rgb.r = p;
-            rgb.g = q;
-            rgb.b = v;
-            break;
-        case 4:
-            rgb.r = t;
-            rgb.g = p;
-            rgb.b = v;
-            break;
-        default:
-            rgb.r = v;
-            rgb.g = p;
-            rgb.b = q;
-            break;
-    }
+    c[HSV_V] = v;
+    c[HSV_P] = (v * (255 - s)) >> 8;
+    c[HSV_Q] = (v * (255 - ((s * remainder) >> 8))) >> 8;
+    c[HSV_T] = (v * (255 - ((s * (255 - remainder)) >> 8))) >> 8;
+
+    rgb.r = c[pgm_read_byte(&hsv_sectors[region][0])];
+    rgb.g = c[pgm_read_byte(&hsv_sectors[region][1])];
+    rgb.b = c[pgm_read_byte(&hsv_sectors[region][2])];
 
     return rgb;
 }
 
+RGB hsv_to_rgb(HSV hsv) { return hsv_to_rgb_impl(hsv); }
+
+void hsv_to_rgb_batch(const HSV *hsv, RGB *rgb, uint8_t count) {
+    for (uint8_t i = 0; i < count; i++) {
+        // read before writing, hsv and rgb may be the same buffer
+        HSV in = hsv[i];
+        rgb[i] = hsv_to_rgb_impl(in);
+    }
+}
+
 #ifdef RGBW
 #    ifndef MIN
 #        define MIN(a, b) ((a) < (b) ? (a) : (b))
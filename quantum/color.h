@@ -64,6 +64,8 @@ typedef struct PACKED {
 #endif
 
 RGB hsv_to_rgb(HSV hsv);
+// Converts count colours in one pass; hsv and rgb may point at the same buffer
+void hsv_to_rgb_batch(const HSV *hsv, RGB *rgb, uint8_t count);
 #ifdef RGBW
 void convert_rgb_to_rgbw(LED_TYPE *led);
 #endif
@@ -0,0 +1,53 @@
+#include <stdbool.h>
+#include "led_correction.h"
+#include "config.h"
+
+#ifdef LED_CORRECTION_GAMMA
+#    include <math.h>
+#endif
+
+#ifndef LED_CORRECTION_MAXIMUM_BRIGHTNESS
+#    define LED_CORRECTION_MAXIMUM_BRIGHTNESS 255
+#endif
+
+// Relative intensity of the red, green and blue channels at full white
+#ifndef LED_CORRECTION_WHITE_BALANCE
+#    define LED_CORRECTION_WHITE_BALANCE \
+        { 255, 255, 255 }
+#endif
+
+uint8_t led_correction_lut[3][256];
+uint8_t led_correction_scale = 255;
+
+static const uint8_t white_balance[3] = LED_CORRECTION_WHITE_BALANCE;
+static bool          initialized      = false;
+
+static void led_correction_build(void) {
+    // full scale output of each channel, in units of 1/255
+    uint16_t limit[3];
+    for (uint8_t c = 0; c < 3; c++) {
+        limit[c] = (uint16_t)LED_CORRECTION_MAXIMUM_BRIGHTNESS * white_balance[c];
+    }
+
+    for (uint16_t v = 0; v < 256; v++) {
+#ifdef LED_CORRECTION_GAMMA
+        uint32_t curve = (uint32_t)(pow(v / 255.0, LED_CORRECTION_GAMMA) * 255.0 + 0.5);
+#else
+        uint32_t curve = v;
+#endif
+        for (uint8_t c = 0; c < 3; c++) {
+            led_correction_lut[c][v] = (curve * limit[c] + 255UL * 255 / 2) / (255UL * 255);
+        }
+    }
+    initialized = true;
+}
+
+void led_correction_init(void) {
+    if (!initialized) {
+        led_correction_build();
+    }
+}
+
+void led_correction_set_scale(uint8_t scale) { led_correction_scale = scale; }
+
+uint8_t led_correction_get_scale(void) { return led_correction_scale; }
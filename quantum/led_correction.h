@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+#include "lib/lib8tion/lib8tion.h"
+
+// Output value of each channel (red, green, blue) for every input value,
+// built once from the gamma, brightness limit and white balance
+extern uint8_t led_correction_lut[3][256];
+extern uint8_t led_correction_scale;
+
+void led_correction_init(void);
+
+// Extra brightness scale applied on top of the tables, for example by a
+// power budget. 255 leaves the output unchanged. Changing it is free, the
+// tables are not rebuilt.
+void    led_correction_set_scale(uint8_t scale);
+uint8_t led_correction_get_scale(void);
+
+static inline void led_correction_apply(uint8_t *r, uint8_t *g, uint8_t *b) {
+    *r = led_correction_lut[0][*r];
+    *g = led_correction_lut[1][*g];
+    *b = led_correction_lut[2][*b];
+    if (led_correction_scale != 255) {
+        *r = scale8(*r, led_correction_scale);
+        *g = scale8(*g, led_correction_scale);
+        *b = scale8(*b, led_correction_scale);
+    }
+}
@@ -0,0 +1,287 @@
+#pragma once
+
+// Incremental effect renderer shared by rgb_matrix and led_matrix. It only
+// sequences effects and tracks hits, the effects themselves write pixels of
+// whatever type the subsystem has. The subsystem's .c file includes
+// led_effect_hits.h before its effects and this file after its effect table,
+// having defined:
+//
+//   LED_ENGINE_LED_COUNT       number of LEDs
+//   LED_ENGINE_POINT(i)        point_t position of LED i
+//   LED_ENGINE_CONFIG          config object with an enable field, static
+//                              effects are rendered again when any of it changes
+//   LED_ENGINE_COUNTERS        led_counters_t object read by the effects
+//   LED_ENGINE_EFFECTS         PROGMEM table of led_effect_t in mode order
+//   LED_ENGINE_EFFECT_MAX      number of entries in LED_ENGINE_EFFECTS
+//   LED_ENGINE_FLUSH_LIMIT     default milliseconds between frames
+//   LED_ENGINE_FLUSH()         sends the rendered frame to the driver
+//
+// and optionally:
+//
+//   LED_ENGINE_TEST()          renders the factory test pattern for mode UINT8_MAX
+//   LED_ENGINE_KEYREACTIVE     tracks hits in g_last_hit_tracker
+//   LED_ENGINE_RENDER_BUDGET   microseconds of rendering per task run
+
+#include "host.h"
+#include "led_effect_hits.h"
+#ifdef LED_CORRECTION_ENABLE
+#    include "led_correction.h"
+#endif
+
+#ifdef LED_ENGINE_RENDER_BUDGET
+#    if defined(__AVR__)
+#        include <avr/io.h>
+#        include <util/atomic.h>
+#    elif defined(PROTOCOL_CHIBIOS)
+#        include "ch.h"
+#    else
+#        error "A render budget is not supported on this platform"
+#    endif
+#endif
+
+static uint8_t         led_last_enable   = UINT8_MAX;
+static uint8_t         led_last_effect   = UINT8_MAX;
+static effect_params_t led_effect_params = {0, 0xFF};
+static led_task_states led_task_state    = SYNCING;
+
+static uint8_t led_engine_get_effect_flags(uint8_t mode) { return mode < LED_ENGINE_EFFECT_MAX ? pgm_read_byte(&LED_ENGINE_EFFECTS[mode].flags) : LED_EFFECT_FLAG_NONE; }
+
+static uint16_t led_engine_get_effect_interval(uint8_t mode) {
+    uint8_t interval = mode < LED_ENGINE_EFFECT_MAX ? pgm_read_byte(&LED_ENGINE_EFFECTS[mode].interval) : 0;
+    return interval ? interval : LED_ENGINE_FLUSH_LIMIT;
+}
+
+// Everything a static effect's frame, or the indicators drawn over it, is
+// expected to depend on. While it matches the last rendered frame, static
+// effects are not rendered or flushed again.
+typedef struct PACKED {
+    uint8_t       effect;
+    uint8_t       config[sizeof(LED_ENGINE_CONFIG)];
+    led_flags_t   flags;
+    layer_state_t layers;
+    layer_state_t default_layers;
+    uint8_t       mods;
+    uint8_t       leds;
+#ifdef LED_CORRECTION_ENABLE
+    uint8_t correction_scale;
+#endif
+} led_static_inputs_t;
+
+static led_static_inputs_t led_static_inputs;
+static bool                led_refresh_required = true;
+
+static void led_static_inputs_read(led_static_inputs_t *inputs, uint8_t effect) {
+    inputs->effect = effect;
+    memcpy(inputs->config, &LED_ENGINE_CONFIG, sizeof(inputs->config));
+    inputs->flags          = led_effect_params.flags;
+    inputs->layers         = layer_state;
+    inputs->default_layers = default_layer_state;
+    inputs->mods           = get_mods();
+    inputs->leds           = host_keyboard_leds();
+#ifdef LED_CORRECTION_ENABLE
+    inputs->correction_scale = led_correction_get_scale();
+#endif
+}
+
+static bool led_static_frame_current(uint8_t effect) {
+    if (led_refresh_required || effect != led_last_effect || !(led_engine_get_effect_flags(effect) & LED_EFFECT_FLAG_STATIC)) {
+        return false;
+    }
+
+    led_static_inputs_t inputs;
+    led_static_inputs_read(&inputs, effect);
+    return memcmp(&inputs, &led_static_inputs, sizeof(inputs)) == 0;
+}
+
+static void led_task_timers(void) {
+    // Update double buffer timers
+    uint16_t deltaTime  = timer_elapsed32(led_counters_buffer);
+    led_counters_buffer = timer_read32();
+    if (LED_ENGINE_COUNTERS.any_key_hit < UINT32_MAX) {
+        if (UINT32_MAX - deltaTime < LED_ENGINE_COUNTERS.any_key_hit) {
+            LED_ENGINE_COUNTERS.any_key_hit = UINT32_MAX;
+        } else {
+            LED_ENGINE_COUNTERS.any_key_hit += deltaTime;
+        }
+    }
+
+    // Drop the oldest hits once they are past UINT16_MAX, or their splash
+    // ring has grown past every LED
+#ifdef LED_ENGINE_KEYREACTIVE
+    while (g_last_hit_tracker.count) {
+        uint8_t  slot = g_last_hit_tracker.head;
+        uint32_t age  = led_counters_buffer - g_last_hit_tracker.time[slot];
+        if (age < UINT16_MAX) {
+            uint16_t tick = scale16by8(age, LED_ENGINE_CONFIG.speed);
+            if (tick <= UINT8_MAX || tick - UINT8_MAX <= led_engine_hit_reach(g_last_hit_tracker.x[slot], g_last_hit_tracker.y[slot])) break;
+        }
+        g_last_hit_tracker.head = last_hit_slot(1);
+        g_last_hit_tracker.count--;
+    }
+#endif  // LED_ENGINE_KEYREACTIVE
+}
+
+static void led_task_sync(uint8_t effect) {
+    // next task
+    if (timer_elapsed32(LED_ENGINE_COUNTERS.tick) >= led_engine_get_effect_interval(effect) && !led_static_frame_current(effect)) led_task_state = STARTING;
+}
+
+static void led_task_start(uint8_t effect) {
+    // reset iter
+    led_effect_params.iter = 0;
+
+    // remember what this frame is rendered from
+    led_static_inputs_read(&led_static_inputs, effect);
+    led_refresh_required = false;
+
+    // update double buffers
+    LED_ENGINE_COUNTERS.tick = led_counters_buffer;
+
+    // next task
+    led_task_state = RENDERING;
+}
+
+static void led_task_render(uint8_t effect) {
+    bool rendering         = false;
+    led_effect_params.init = (effect != led_last_effect) || (LED_ENGINE_CONFIG.enable != led_last_enable);
+
+#ifdef LED_ENGINE_TEST
+    // Factory default magic value
+    if (effect == UINT8_MAX) {
+        LED_ENGINE_TEST();
+        led_task_state = FLUSHING;
+        return;
+    }
+#endif
+
+    // each effect can opt to do calculations
+    // and/or request PWM buffer updates.
+    if (effect < LED_ENGINE_EFFECT_MAX) {
+        led_effect_f render = (led_effect_f)pgm_read_ptr(&LED_ENGINE_EFFECTS[effect].render);
+        rendering           = render(&led_effect_params);
+    }
+
+    led_effect_params.iter++;
+
+    // next task
+    if (!rendering) {
+        led_task_state = FLUSHING;
+        if (!led_effect_params.init && effect == 0) {
+            // We only need to flush once if we are NONE
+            led_task_state = SYNCING;
+        }
+    }
+}
+
+#ifdef LED_ENGINE_RENDER_BUDGET
+#    if defined(__AVR__)
+typedef uint16_t led_render_time_t;
+
+// Microseconds from the 1ms timer plus the timer0 count, wraps every 65ms
+static uint16_t led_render_clock(void) {
+    uint16_t ms;
+    uint8_t  raw;
+    bool     tick_pending;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        ms  = timer_count;
+        raw = TIMER_RAW;
+#        if defined(__AVR_ATmega32A__)
+        tick_pending = TIFR & _BV(OCF0);
+#        else
+        tick_pending = TIFR0 & _BV(OCF0A);
+#        endif
+    }
+    // the counter wrapped but the interrupt has not run yet
+    if (tick_pending && raw < TIMER_RAW_TOP / 2) ms++;
+    return ms * 1000 + (uint16_t)((uint32_t)raw * 1000 / TIMER_RAW_TOP);
+}
+
+static uint16_t led_render_elapsed(uint16_t since) { return led_render_clock() - since; }
+#    elif defined(PORT_SUPPORTS_RT) && (PORT_SUPPORTS_RT == TRUE) && defined(STM32_HCLK)
+typedef rtcnt_t led_render_time_t;
+
+// Core cycles, which the port counts from boot. The difference is taken
+// before converting to microseconds, so the 32 bit wrap is harmless.
+static rtcnt_t led_render_clock(void) { return chSysGetRealtimeCounterX(); }
+
+static uint16_t led_render_elapsed(rtcnt_t since) {
+    uint32_t us = (rtcnt_t)(led_render_clock() - since) / (STM32_HCLK / 1000000);
+    return us < UINT16_MAX ? us : UINT16_MAX;
+}
+#    else
+typedef uint16_t led_render_time_t;
+
+// System ticks, converted on difference so the 16 bit wrap is harmless.
+// Most chunks end within one tick, count those as one tick instead of free.
+static uint16_t led_render_clock(void) { return (uint16_t)chVTGetSystemTimeX(); }
+
+static uint16_t led_render_elapsed(uint16_t since) {
+    uint16_t ticks = led_render_clock() - since;
+    return TIME_I2US(ticks ? ticks : 1);
+}
+#    endif
+
+static uint8_t  led_render_effect = UINT8_MAX;
+static uint16_t led_render_cost   = 0;
+
+// Renders chunks until the next one is expected to overrun the budget.
+// The cost of a chunk is a running average for the current effect, so
+// cheap effects finish a frame in one task run and costly ones spread out.
+static void led_task_render_budget(uint8_t effect) {
+    // a key event was processed this scan, leave the time to it
+    if (led_key_pending) return;
+
+    if (effect != led_render_effect) {
+        led_render_effect = effect;
+        led_render_cost   = 0;
+    }
+
+    led_render_time_t start = led_render_clock();
+    uint16_t          spent;
+    do {
+        led_render_time_t chunk_start = led_render_clock();
+        led_task_render(effect);
+        uint16_t cost   = led_render_elapsed(chunk_start);
+        led_render_cost = led_render_cost ? ((uint32_t)led_render_cost * 3 + cost) / 4 : cost;
+        spent           = led_render_elapsed(start);
+    } while (led_task_state == RENDERING && (uint32_t)spent + led_render_cost <= LED_ENGINE_RENDER_BUDGET);
+}
+#endif  // LED_ENGINE_RENDER_BUDGET
+
+static void led_task_flush(uint8_t effect) {
+    // update last trackers after the first full render so we can init over several frames
+    led_last_effect = effect;
+    led_last_enable = LED_ENGINE_CONFIG.enable;
+
+    // update pwm buffers
+    LED_ENGINE_FLUSH();
+
+    // next task
+    led_task_state = SYNCING;
+}
+
+// Advances the engine by one step towards the next frame of effect
+static void led_engine_task(uint8_t effect) {
+    switch (led_task_state) {
+        case STARTING:
+            led_task_start(effect);
+            break;
+        case RENDERING:
+#ifdef LED_ENGINE_RENDER_BUDGET
+            led_task_render_budget(effect);
+#else
+            led_task_render(effect);
+#endif
+            break;
+        case FLUSHING:
+            led_task_flush(effect);
+            break;
+        case SYNCING:
+            led_task_sync(effect);
+            break;
+    }
+
+#ifdef LED_ENGINE_RENDER_BUDGET
+    led_key_pending = false;
+#endif
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+// Hit tracking and timing shared by the rgb_matrix and led_matrix effects,
+// see led_effect_engine.h for the macros the including file defines.
+
+#ifndef MIN
+#    define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#    define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+// Time of the current task run, see led_task_timers()
+static uint32_t led_counters_buffer;
+
+#ifdef LED_ENGINE_RENDER_BUDGET
+static bool led_key_pending = false;
+#endif
+
+// A key event is being processed, renders leave the rest of the scan to it
+static void led_engine_key_event(void) {
+#ifdef LED_ENGINE_RENDER_BUDGET
+    led_key_pending = true;
+#endif
+}
+
+#ifdef LED_ENGINE_KEYREACTIVE
+last_hit_t g_last_hit_tracker;
+
+// LED indexes bucketed by grid cell, so splash effects only visit the
+// cells a hit's ring passes through. Cell c holds the LEDs
+// g_led_grid[g_led_grid_start[c]] to g_led_grid[g_led_grid_start[c + 1] - 1].
+uint8_t g_led_grid_start[LED_EFFECT_GRID_CELLS + 1];
+uint8_t g_led_grid[LED_ENGINE_LED_COUNT];
+
+// Bounding box of all LEDs, used to expire hits whose ring has left it
+static point_t led_bounds_min;
+static point_t led_bounds_max;
+
+static uint8_t led_engine_grid_cell(point_t point) { return (point.y >> LED_EFFECT_GRID_SHIFT) * LED_EFFECT_GRID_SIZE + (point.x >> LED_EFFECT_GRID_SHIFT); }
+
+static void led_engine_update_grid(void) {
+    uint8_t fill[LED_EFFECT_GRID_CELLS];
+
+    memset(g_led_grid_start, 0, sizeof(g_led_grid_start));
+    led_bounds_min = (point_t){UINT8_MAX, UINT8_MAX};
+    led_bounds_max = (point_t){0, 0};
+    for (uint8_t i = 0; i < LED_ENGINE_LED_COUNT; i++) {
+        point_t point = LED_ENGINE_POINT(i);
+        g_led_grid_start[led_engine_grid_cell(point) + 1]++;
+        led_bounds_min.x = MIN(led_bounds_min.x, point.x);
+        led_bounds_min.y = MIN(led_bounds_min.y, point.y);
+        led_bounds_max.x = MAX(led_bounds_max.x, point.x);
+        led_bounds_max.y = MAX(led_bounds_max.y, point.y);
+    }
+    for (uint8_t c = 0; c < LED_EFFECT_GRID_CELLS; c++) {
+        g_led_grid_start[c + 1] += g_led_grid_start[c];
+        fill[c] = g_led_grid_start[c];
+    }
+    for (uint8_t i = 0; i < LED_ENGINE_LED_COUNT; i++) {
+        g_led_grid[fill[led_engine_grid_cell(LED_ENGINE_POINT(i))]++] = i;
+    }
+}
+
+// Buffer slot of the n-th oldest hit
+static uint8_t last_hit_slot(uint8_t n) {
+    uint8_t slot = g_last_hit_tracker.head + n;
+    return slot < LED_HITS_TO_REMEMBER ? slot : slot - LED_HITS_TO_REMEMBER;
+}
+
+// Age of a hit at the start of the current frame, saturating at UINT16_MAX.
+// Hits made during the frame count as too old to show until the next one.
+static uint16_t last_hit_age(uint8_t slot) {
+    uint32_t age = LED_ENGINE_COUNTERS.tick - g_last_hit_tracker.time[slot];
+    return age < UINT16_MAX ? age : UINT16_MAX;
+}
+
+// Distance from (x, y) to the farthest corner of the LED bounding box
+static uint8_t led_engine_hit_reach(uint8_t x, uint8_t y) {
+    uint16_t dx = MAX(abs((int16_t)x - led_bounds_min.x), abs((int16_t)x - led_bounds_max.x));
+    uint16_t dy = MAX(abs((int16_t)y - led_bounds_min.y), abs((int16_t)y - led_bounds_max.y));
+    uint32_t d2 = (uint32_t)dx * dx + (uint32_t)dy * dy;
+    return d2 > UINT16_MAX ? UINT8_MAX : sqrt16(d2);
+}
+
+static void led_engine_record_hit(uint8_t led) {
+    uint8_t slot;
+    if (g_last_hit_tracker.count < LED_HITS_TO_REMEMBER) {
+        slot = last_hit_slot(g_last_hit_tracker.count++);
+    } else {
+        // full, overwrite the oldest hit
+        slot                    = g_last_hit_tracker.head;
+        g_last_hit_tracker.head = last_hit_slot(1);
+    }
+    g_last_hit_tracker.x[slot]     = LED_ENGINE_POINT(led).x;
+    g_last_hit_tracker.y[slot]     = LED_ENGINE_POINT(led).y;
+    g_last_hit_tracker.index[slot] = led;
+    g_last_hit_tracker.time[slot]  = led_counters_buffer;
+}
+#endif  // LED_ENGINE_KEYREACTIVE
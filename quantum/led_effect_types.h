@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(__GNUC__)
+#    define PACKED __attribute__((__packed__))
+#else
+#    define PACKED
+#endif
+
+#if defined(_MSC_VER)
+#    pragma pack(push, 1)
+#endif
+
+// Last led hit
+#ifndef LED_HITS_TO_REMEMBER
+#    define LED_HITS_TO_REMEMBER 8
+#endif  // LED_HITS_TO_REMEMBER
+
+// Splash effects index LEDs by 32x32 cells of their position
+#define LED_EFFECT_GRID_SHIFT 5
+#define LED_EFFECT_GRID_SIZE (256 >> LED_EFFECT_GRID_SHIFT)
+#define LED_EFFECT_GRID_CELLS (LED_EFFECT_GRID_SIZE * LED_EFFECT_GRID_SIZE)
+
+// Ring buffer of hits, oldest at head. Ages are worked out from the
+// timestamps when read, see last_hit_slot() and last_hit_age().
+typedef struct PACKED {
+    uint8_t  count;
+    uint8_t  head;
+    uint8_t  x[LED_HITS_TO_REMEMBER];
+    uint8_t  y[LED_HITS_TO_REMEMBER];
+    uint8_t  index[LED_HITS_TO_REMEMBER];
+    uint32_t time[LED_HITS_TO_REMEMBER];
+} last_hit_t;
+
+typedef enum led_task_states { STARTING, RENDERING, FLUSHING, SYNCING } led_task_states;
+
+typedef uint8_t led_flags_t;
+
+typedef struct PACKED {
+    uint8_t     iter;
+    led_flags_t flags;
+    bool        init;
+} effect_params_t;
+
+typedef struct PACKED {
+    // Global tick at 20 Hz
+    uint32_t tick;
+    // Ticks since this key was last hit.
+    uint32_t any_key_hit;
+} led_counters_t;
+
+typedef struct PACKED {
+    uint8_t x;
+    uint8_t y;
+} point_t;
+
+typedef bool (*led_effect_f)(effect_params_t *params);
+
+#define LED_EFFECT_FLAG_NONE 0x00
+#define LED_EFFECT_FLAG_STATIC 0x01       // frame only depends on the config
+#define LED_EFFECT_FLAG_REACTIVE 0x02     // reads g_last_hit_tracker
+#define LED_EFFECT_FLAG_FRAMEBUFFER 0x04  // reads a frame buffer
+
+// Effect descriptor, tables of these are kept in PROGMEM in mode order.
+// Not packed, so render stays aligned for pgm_read_ptr on Cortex-M0.
+typedef struct {
+    led_effect_f render;
+    uint8_t      flags;
+    uint8_t      interval;  // milliseconds between frames, 0 for the flush limit
+} led_effect_t;
+
+#define HAS_FLAGS(bits, flags) ((bits & flags) == flags)
+#define HAS_ANY_FLAGS(bits, flags) ((bits & flags) != 0x00)
+
+#define LED_FLAG_ALL 0xFF
+#define LED_FLAG_NONE 0x00
+#define LED_FLAG_MODIFIER 0x01
+#define LED_FLAG_UNDERGLOW 0x02
+#define LED_FLAG_KEYLIGHT 0x04
+
+#define NO_LED 255
+
+#if defined(_MSC_VER)
+#    pragma pack(pop)
+#endif
@@ -27,6 +27,8 @@
 #include <string.h>
 #include <math.h>
 
+#include "lib/lib8tion/lib8tion.h"
+
 led_config_t led_matrix_config;
 
 #ifndef MAX
@@ -55,14 +57,25 @@ led_config_t led_matrix_config;
 
 bool g_suspend_state = false;
 
-// Global tick at 20 Hz
-uint32_t g_tick = 0;
-
-// Ticks since this key was last hit.
-uint8_t g_key_hit[LED_DRIVER_LED_COUNT];
+led_counters_t g_led_counters;
+
+// The effects are sequenced by the shared LED effect engine
+#define LED_ENGINE_LED_COUNT LED_DRIVER_LED_COUNT
+#define LED_ENGINE_POINT(i) ((point_t){g_leds[i].point.x, g_leds[i].point.y})
+#define LED_ENGINE_CONFIG led_matrix_config
+#define LED_ENGINE_COUNTERS g_led_counters
+#define LED_ENGINE_EFFECTS led_matrix_effects
+#define LED_ENGINE_EFFECT_MAX LED_MATRIX_EFFECT_MAX
+#define LED_ENGINE_FLUSH_LIMIT LED_MATRIX_LED_FLUSH_LIMIT
+#define LED_ENGINE_FLUSH() led_matrix_update_pwm_buffers()
+#ifdef LED_MATRIX_KEYREACTIVE_ENABLED
+#    define LED_ENGINE_KEYREACTIVE
+#endif
+#ifdef LED_MATRIX_RENDER_BUDGET
+#    define LED_ENGINE_RENDER_BUDGET LED_MATRIX_RENDER_BUDGET
+#endif
 
-// Ticks since any key was last hit.
-uint32_t g_any_key_hit = 0;
+#include "led_effect_hits.h"
 
 uint32_t eeconfig_read_led_matrix(void) { return eeprom_read_dword(EECONFIG_LED_MATRIX); }
 
@@ -85,13 +98,6 @@ void eeconfig_debug_led_matrix(void) {
     dprintf("led_matrix_config.speed = %d\n", led_matrix_config.speed);
 }
 
-// Last led hit
-#ifndef LED_HITS_TO_REMEMBER
-#    define LED_HITS_TO_REMEMBER 8
-#endif
-uint8_t g_last_led_hit[LED_HITS_TO_REMEMBER] = {255};
-uint8_t g_last_led_count                     = 0;
-
 void map_row_column_to_led(uint8_t row, uint8_t column, uint8_t *led_i, uint8_t *led_count) {
     led_matrix led;
     *led_count = 0;
@@ -113,83 +119,105 @@ void led_matrix_set_index_value(int index, uint8_t value) { led_matrix_driver.se
 void led_matrix_set_index_value_all(uint8_t value) { led_matrix_driver.set_value_all(value); }
 
 bool process_led_matrix(uint16_t keycode, keyrecord_t *record) {
+    led_engine_key_event();
+    // Wakes LED_DISABLE_AFTER_TIMEOUT, with or without reactive effects
     if (record->event.pressed) {
-        uint8_t led[8], led_count;
-        map_row_column_to_led(record->event.key.row, record->event.key.col, led, &led_count);
-        if (led_count > 0) {
-            for (uint8_t i = LED_HITS_TO_REMEMBER; i > 1; i--) {
-                g_last_led_hit[i - 1] = g_last_led_hit[i - 2];
-            }
-            g_last_led_hit[0] = led[0];
-            g_last_led_count  = MIN(LED_HITS_TO_REMEMBER, g_last_led_count + 1);
-        }
-        for (uint8_t i = 0; i < led_count; i++) g_key_hit[led[i]] = 0;
-        g_any_key_hit = 0;
-    } else {
-#ifdef LED_MATRIX_KEYRELEASES
-        uint8_t led[8], led_count;
+        g_led_counters.any_key_hit = 0;
+    }
+#ifdef LED_MATRIX_KEYREACTIVE_ENABLED
+    uint8_t led[LED_HITS_TO_REMEMBER];
+    uint8_t led_count = 0;
+
+#    if defined(LED_MATRIX_KEYRELEASES)
+    if (!record->event.pressed) {
+#    else
+    if (record->event.pressed) {
+#    endif
         map_row_column_to_led(record->event.key.row, record->event.key.col, led, &led_count);
-        for (uint8_t i = 0; i < led_count; i++) g_key_hit[led[i]] = 255;
+    }
 
-        g_any_key_hit = 255;
-#endif
+    for (uint8_t i = 0; i < led_count; i++) {
+        led_engine_record_hit(led[i]);
     }
+#endif  // LED_MATRIX_KEYREACTIVE_ENABLED
     return true;
 }
 
 void led_matrix_set_suspend_state(bool state) { g_suspend_state = state; }
 
-// All LEDs off
-void led_matrix_all_off(void) { led_matrix_set_index_value_all(0); }
+// All LEDs off, only rendered once
+static bool led_matrix_none(effect_params_t *params) {
+    if (!params->init) {
+        return false;
+    }
+
+    LED_MATRIX_USE_LIMITS(led_min, led_max);
+    for (uint8_t i = led_min; i < led_max; i++) {
+        led_matrix_set_index_value(i, 0);
+    }
+    return led_max < LED_DRIVER_LED_COUNT;
+}
 
 // Uniform brightness
-void led_matrix_uniform_brightness(void) { led_matrix_set_index_value_all(LED_MATRIX_MAXIMUM_BRIGHTNESS / BACKLIGHT_LEVELS * led_matrix_config.val); }
+static bool led_matrix_uniform_brightness(effect_params_t *params) {
+    LED_MATRIX_USE_LIMITS(led_min, led_max);
+    uint8_t value = LED_MATRIX_MAXIMUM_BRIGHTNESS / BACKLIGHT_LEVELS * led_matrix_config.val;
+    for (uint8_t i = led_min; i < led_max; i++) {
+        led_matrix_set_index_value(i, value);
+    }
+    return led_max < LED_DRIVER_LED_COUNT;
+}
 
-void led_matrix_custom(void) {}
+#ifdef LED_MATRIX_KEYREACTIVE_ENABLED
+// Hit keys light up and fade out, over 2s at speed 0 down to 250ms at speed 3
+static bool led_matrix_solid_reactive_simple(effect_params_t *params) {
+    LED_MATRIX_USE_LIMITS(led_min, led_max);
+    for (uint8_t i = led_min; i < led_max; i++) {
+        uint16_t age = UINT16_MAX;
+        // Reverse search to find most recent key hit
+        for (int8_t j = g_last_hit_tracker.count - 1; j >= 0; j--) {
+            uint8_t slot = last_hit_slot(j);
+            if (g_last_hit_tracker.index[slot] == i) {
+                age = last_hit_age(slot);
+                break;
+            }
+        }
 
-void led_matrix_task(void) {
-    if (!led_matrix_config.enable) {
-        led_matrix_all_off();
-        led_matrix_indicators();
-        return;
+        uint16_t offset = age >> (3 - MIN(led_matrix_config.speed, 3));
+        led_matrix_set_index_value(i, offset < UINT8_MAX ? scale8(UINT8_MAX - offset, led_matrix_config.val) : 0);
     }
+    return led_max < LED_DRIVER_LED_COUNT;
+}
+#endif  // LED_MATRIX_KEYREACTIVE_ENABLED
+
+// Effect descriptors in mode order
+static const led_effect_t led_matrix_effects[] PROGMEM = {
+    [LED_MATRIX_NONE]               = {led_matrix_none, LED_EFFECT_FLAG_STATIC, 0},
+    [LED_MATRIX_UNIFORM_BRIGHTNESS] = {led_matrix_uniform_brightness, LED_EFFECT_FLAG_STATIC, 0},
+#ifdef LED_MATRIX_KEYREACTIVE_ENABLED
+    [LED_MATRIX_SOLID_REACTIVE_SIMPLE] = {led_matrix_solid_reactive_simple, LED_EFFECT_FLAG_REACTIVE, 0},
+#endif
+};
 
-    g_tick++;
+_Static_assert(sizeof(led_matrix_effects) / sizeof(led_matrix_effects[0]) == LED_MATRIX_EFFECT_MAX, "led_matrix_effects does not match enum led_matrix_effects");
 
-    if (g_any_key_hit < 0xFFFFFFFF) {
-        g_any_key_hit++;
-    }
+#include "led_effect_engine.h"
 
-    for (int led = 0; led < LED_DRIVER_LED_COUNT; led++) {
-        if (g_key_hit[led] < 255) {
-            if (g_key_hit[led] == 254) g_last_led_count = MAX(g_last_led_count - 1, 0);
-            g_key_hit[led]++;
-        }
-    }
+void led_matrix_refresh(void) { led_refresh_required = true; }
+
+void led_matrix_task(void) {
+    led_task_timers();
 
     // Ideally we would also stop sending zeros to the LED driver PWM buffers
     // while suspended and just do a software shutdown. This is a cheap hack for now.
-    bool    suspend_backlight = ((g_suspend_state && LED_DISABLE_WHEN_USB_SUSPENDED) || (LED_DISABLE_AFTER_TIMEOUT > 0 && g_any_key_hit > LED_DISABLE_AFTER_TIMEOUT * 60 * 20));
-    uint8_t effect            = suspend_backlight ? 0 : led_matrix_config.mode;
-
-    // this gets ticked at 20 Hz.
-    // each effect can opt to do calculations
-    // and/or request PWM buffer updates.
-    switch (effect) {
-        case LED_MATRIX_UNIFORM_BRIGHTNESS:
-            led_matrix_uniform_brightness();
-            break;
-        default:
-            led_matrix_custom();
-            break;
-    }
+    bool    suspend_backlight = ((g_suspend_state && LED_DISABLE_WHEN_USB_SUSPENDED) || (LED_DISABLE_AFTER_TIMEOUT > 0 && g_led_counters.any_key_hit > LED_DISABLE_AFTER_TIMEOUT * 60 * 20));
+    uint8_t effect            = suspend_backlight || !led_matrix_config.enable ? 0 : led_matrix_config.mode;
+
+    led_engine_task(effect);
 
     if (!suspend_backlight) {
         led_matrix_indicators();
     }
-
-    // Tell the LED driver to update its state
-    led_matrix_driver.flush();
 }
 
 void led_matrix_indicators(void) {
@@ -224,10 +252,11 @@ void led_matrix_init(void) {
     // Wait half a second for the driver to finish initializing
     wait_ms(500);
 
-    // clear the key hits
-    for (int led = 0; led < LED_DRIVER_LED_COUNT; led++) {
-        g_key_hit[led] = 255;
-    }
+#ifdef LED_MATRIX_KEYREACTIVE_ENABLED
+    led_engine_update_grid();
+    g_last_hit_tracker.count = 0;
+    g_last_hit_tracker.head  = 0;
+#endif  // LED_MATRIX_KEYREACTIVE_ENABLED
 
     if (!eeconfig_is_enabled()) {
         dprintf("led_matrix_init_drivers eeconfig is not enabled.\n");
@@ -280,7 +309,7 @@ static uint8_t decrement(uint8_t value, uint8_t step, uint8_t min, uint8_t max)
 //     }
 // }
 
-uint32_t led_matrix_get_tick(void) { return g_tick; }
+uint32_t led_matrix_get_tick(void) { return g_led_counters.tick; }
 
 void led_matrix_toggle(void) {
     led_matrix_config.enable ^= 1;
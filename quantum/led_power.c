@@ -0,0 +1,51 @@
+#include "led_power.h"
+#include "led_correction.h"
+#include "config.h"
+
+// Current the LEDs may draw together, leave some of the USB budget for the rest of the keyboard
+#ifndef LED_POWER_BUDGET_MA
+#    define LED_POWER_BUDGET_MA 400
+#endif
+
+// Current of a single channel at full output
+#ifndef LED_POWER_CHANNEL_MA
+#    define LED_POWER_CHANNEL_MA 20
+#endif
+
+// Current of each LED with all of its channels off
+#ifndef LED_POWER_IDLE_MA
+#    define LED_POWER_IDLE_MA 1
+#endif
+
+// The scale only goes back up once it can rise by this much, so a frame
+// right at the budget does not have the brightness flicker up and down
+#ifndef LED_POWER_HYSTERESIS
+#    define LED_POWER_HYSTERESIS 4
+#endif
+
+static uint16_t power_current = 0;
+
+bool led_power_limit(uint32_t channel_sum, uint16_t led_count) {
+    uint32_t idle    = (uint32_t)led_count * LED_POWER_IDLE_MA;
+    uint32_t current = idle + channel_sum * LED_POWER_CHANNEL_MA / 255;
+    power_current    = current < UINT16_MAX ? current : UINT16_MAX;
+
+    // The channel current is proportional to the correction scale, so this
+    // is the scale at which the frame just fits the budget
+    uint8_t  scale  = led_correction_get_scale();
+    uint32_t target = 255;
+    if (idle >= LED_POWER_BUDGET_MA) {
+        target = 0;
+    } else if (channel_sum) {
+        target = (LED_POWER_BUDGET_MA - idle) * 255UL * scale / (channel_sum * LED_POWER_CHANNEL_MA);
+        if (target > 255) target = 255;
+    }
+
+    if (target < scale || target >= (uint32_t)scale + LED_POWER_HYSTERESIS || (target == 255 && scale != 255)) {
+        led_correction_set_scale(target);
+        return true;
+    }
+    return false;
+}
+
+uint16_t led_power_get_current(void) { return power_current; }
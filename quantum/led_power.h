@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Estimates the current of each frame sent to the LEDs, and scales the
+// output down through led_correction_set_scale() when it would exceed
+// LED_POWER_BUDGET_MA. channel_sum is the sum of every channel value of the
+// frame as sent, after correction. Returns true when the scale changed, the
+// next frame is then sent at the new scale.
+bool led_power_limit(uint32_t channel_sum, uint16_t led_count);
+
+// Estimated current of the last frame, in milliamps
+uint16_t led_power_get_current(void);
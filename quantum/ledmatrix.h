@@ -24,6 +24,31 @@
 #    error You must define BACKLIGHT_ENABLE with LED_MATRIX_ENABLE
 #endif
 
+#include "led_effect_types.h"
+
+#if defined(LED_MATRIX_KEYPRESSES) || defined(LED_MATRIX_KEYRELEASES)
+#    define LED_MATRIX_KEYREACTIVE_ENABLED
+#endif
+
+#ifndef LED_MATRIX_LED_FLUSH_LIMIT
+#    define LED_MATRIX_LED_FLUSH_LIMIT 16
+#endif
+
+#ifndef LED_MATRIX_LED_PROCESS_LIMIT
+#    define LED_MATRIX_LED_PROCESS_LIMIT (LED_DRIVER_LED_COUNT + 4) / 5
+#endif
+
+#if LED_MATRIX_LED_PROCESS_LIMIT > 0 && LED_MATRIX_LED_PROCESS_LIMIT < LED_DRIVER_LED_COUNT
+#    define LED_MATRIX_USE_LIMITS(min, max)                        \
+        uint8_t min = LED_MATRIX_LED_PROCESS_LIMIT * params->iter; \
+        uint8_t max = min + LED_MATRIX_LED_PROCESS_LIMIT;          \
+        if (max > LED_DRIVER_LED_COUNT) max = LED_DRIVER_LED_COUNT;
+#else
+#    define LED_MATRIX_USE_LIMITS(min, max) \
+        uint8_t min = 0;                    \
+        uint8_t max = LED_DRIVER_LED_COUNT;
+#endif
+
 typedef struct Point {
     uint8_t x;
     uint8_t y;
@@ -61,7 +86,11 @@ typedef union {
 } led_config_t;
 
 enum led_matrix_effects {
-    LED_MATRIX_UNIFORM_BRIGHTNESS = 1,
+    LED_MATRIX_NONE = 0,
+    LED_MATRIX_UNIFORM_BRIGHTNESS,
+#ifdef LED_MATRIX_KEYREACTIVE_ENABLED
+    LED_MATRIX_SOLID_REACTIVE_SIMPLE,
+#endif
     // All new effects go above this line
     LED_MATRIX_EFFECT_MAX
 };
@@ -93,6 +122,10 @@ bool process_led_matrix(uint16_t keycode, keyrecord_t *record);
 
 uint32_t led_matrix_get_tick(void);
 
+// Renders static effects again on the next task run, for when something
+// they or the indicators depend on has changed outside of led_matrix
+void led_matrix_refresh(void);
+
 void    led_matrix_toggle(void);
 void    led_matrix_enable(void);
 void    led_matrix_enable_noeeprom(void);
@@ -124,4 +157,12 @@ typedef struct {
 
 extern const led_matrix_driver_t led_matrix_driver;
 
+extern led_config_t   led_matrix_config;
+extern led_counters_t g_led_counters;
+#ifdef LED_MATRIX_KEYREACTIVE_ENABLED
+extern last_hit_t g_last_hit_tracker;
+extern uint8_t    g_led_grid_start[LED_EFFECT_GRID_CELLS + 1];
+extern uint8_t    g_led_grid[LED_DRIVER_LED_COUNT];
+#endif
+
 #endif
@@ -20,6 +20,12 @@
 #include "progmem.h"
 #include "config.h"
 #include "eeprom.h"
+#ifdef LED_CORRECTION_ENABLE
+#    include "led_correction.h"
+#endif
+#ifdef LED_POWER_LIMIT_ENABLE
+#    include "led_power.h"
+#endif
 #include <string.h>
 #include <math.h>
 
@@ -31,9 +37,46 @@ const point_t k_rgb_matrix_center = {112, 32};
 const point_t k_rgb_matrix_center = RGB_MATRIX_CENTER;
 #endif
 
+// Distance and angle of every LED from the center, computed once at init
+// so the runners do not need a sqrt16() and atan2_8() per LED per frame
+led_geometry_t g_led_geometry[DRIVER_LED_TOTAL];
+
+// The effects are sequenced by the shared LED effect engine
+#define LED_ENGINE_LED_COUNT DRIVER_LED_TOTAL
+#define LED_ENGINE_POINT(i) (g_led_config.point[i])
+#define LED_ENGINE_CONFIG rgb_matrix_config
+#define LED_ENGINE_COUNTERS g_rgb_counters
+#define LED_ENGINE_EFFECTS rgb_matrix_effects
+#define LED_ENGINE_EFFECT_MAX RGB_MATRIX_EFFECT_MAX
+#define LED_ENGINE_FLUSH_LIMIT RGB_MATRIX_LED_FLUSH_LIMIT
+#define LED_ENGINE_FLUSH() rgb_matrix_update_pwm_buffers()
+#define LED_ENGINE_TEST() rgb_matrix_test()
+#ifdef RGB_MATRIX_KEYREACTIVE_ENABLED
+#    define LED_ENGINE_KEYREACTIVE
+#endif
+#ifdef RGB_MATRIX_RENDER_BUDGET
+#    define LED_ENGINE_RENDER_BUDGET RGB_MATRIX_RENDER_BUDGET
+#endif
+
+#include "led_effect_hits.h"
+
+void rgb_matrix_update_geometry(void) {
+    for (uint8_t i = 0; i < DRIVER_LED_TOTAL; i++) {
+        int16_t dx              = g_led_config.point[i].x - k_rgb_matrix_center.x;
+        int16_t dy              = g_led_config.point[i].y - k_rgb_matrix_center.y;
+        g_led_geometry[i].dist  = sqrt16(dx * dx + dy * dy);
+        g_led_geometry[i].angle = atan2_8(dy, dx);
+    }
+#ifdef RGB_MATRIX_KEYREACTIVE_ENABLED
+    led_engine_update_grid();
+#endif
+}
+
 // Generic effect runners
+#include "rgb_matrix_runners/effect_frame.h"
 #include "rgb_matrix_runners/effect_runner_dx_dy_dist.h"
 #include "rgb_matrix_runners/effect_runner_dx_dy.h"
+#include "rgb_matrix_runners/effect_runner_dist_angle.h"
 #include "rgb_matrix_runners/effect_runner_i.h"
 #include "rgb_matrix_runners/effect_runner_sin_cos_i.h"
 #include "rgb_matrix_runners/effect_runner_reactive.h"
@@ -41,7 +84,7 @@ const point_t k_rgb_matrix_center = RGB_MATRIX_CENTER;
 
 // ------------------------------------------
 // -----Begin rgb effect includes macros-----
-#define RGB_MATRIX_EFFECT(name)
+#define RGB_MATRIX_EFFECT(name, ...)
 #define RGB_MATRIX_CUSTOM_EFFECT_IMPLS
 
 #include "rgb_matrix_animations/rgb_matrix_effects.inc"
@@ -115,18 +158,12 @@ bool g_suspend_state = false;
 
 rgb_config_t rgb_matrix_config;
 
-rgb_counters_t  g_rgb_counters;
-static uint32_t rgb_counters_buffer;
+rgb_counters_t g_rgb_counters;
 
 #ifdef RGB_MATRIX_FRAMEBUFFER_EFFECTS
 uint8_t rgb_frame_buffer[MATRIX_ROWS][MATRIX_COLS] = {{0}};
 #endif
 
-#ifdef RGB_MATRIX_KEYREACTIVE_ENABLED
-last_hit_t        g_last_hit_tracker;
-static last_hit_t last_hit_buffer;
-#endif  // RGB_MATRIX_KEYREACTIVE_ENABLED
-
 void eeconfig_read_rgb_matrix(void) { eeprom_read_block(&rgb_matrix_config, EECONFIG_RGB_MATRIX, sizeof(rgb_matrix_config)); }
 
 void eeconfig_update_rgb_matrix(void) { eeprom_update_block(&rgb_matrix_config, EECONFIG_RGB_MATRIX, sizeof(rgb_matrix_config)); }
@@ -162,13 +199,52 @@ uint8_t rgb_matrix_map_row_column_to_led(uint8_t row, uint8_t column, uint8_t *l
     return led_count;
 }
 
-void rgb_matrix_update_pwm_buffers(void) { rgb_matrix_driver.flush(); }
+#ifdef LED_POWER_LIMIT_ENABLE
+// Mean channel value of each LED as it is in the driver buffers, and their
+// total, kept up to date as colors are set so flushes need no extra pass
+static uint8_t  rgb_power_level[DRIVER_LED_TOTAL];
+static uint32_t rgb_power_sum = 0;
+#endif
+
+void rgb_matrix_update_pwm_buffers(void) {
+    rgb_matrix_driver.flush();
+#ifdef LED_POWER_LIMIT_ENABLE
+    led_power_limit(rgb_power_sum * 3, DRIVER_LED_TOTAL);
+#endif
+}
 
-void rgb_matrix_set_color(int index, uint8_t red, uint8_t green, uint8_t blue) { rgb_matrix_driver.set_color(index, red, green, blue); }
+// The drivers keep no other copy of the frame, so output correction is
+// applied on the way into their buffers
+void rgb_matrix_set_color(int index, uint8_t red, uint8_t green, uint8_t blue) {
+#ifdef LED_CORRECTION_ENABLE
+    led_correction_apply(&red, &green, &blue);
+#endif
+#ifdef LED_POWER_LIMIT_ENABLE
+    // Indicator code passes NO_LED and other indexes the drivers ignore
+    if (index >= 0 && index < DRIVER_LED_TOTAL) {
+        uint8_t level = ((uint16_t)red + green + blue) / 3;
+        rgb_power_sum += level;
+        rgb_power_sum -= rgb_power_level[index];
+        rgb_power_level[index] = level;
+    }
+#endif
+    rgb_matrix_driver.set_color(index, red, green, blue);
+}
 
-void rgb_matrix_set_color_all(uint8_t red, uint8_t green, uint8_t blue) { rgb_matrix_driver.set_color_all(red, green, blue); }
+void rgb_matrix_set_color_all(uint8_t red, uint8_t green, uint8_t blue) {
+#ifdef LED_CORRECTION_ENABLE
+    led_correction_apply(&red, &green, &blue);
+#endif
+#ifdef LED_POWER_LIMIT_ENABLE
+    uint8_t level = ((uint16_t)red + green + blue) / 3;
+    memset(rgb_power_level, level, sizeof(rgb_power_level));
+    rgb_power_sum = (uint32_t)level * DRIVER_LED_TOTAL;
+#endif
+    rgb_matrix_driver.set_color_all(red, green, blue);
+}
 
 bool process_rgb_matrix(uint16_t keycode, keyrecord_t *record) {
+    led_engine_key_event();
 #ifdef RGB_MATRIX_KEYREACTIVE_ENABLED
     uint8_t led[LED_HITS_TO_REMEMBER];
     uint8_t led_count = 0;
@@ -185,21 +261,8 @@ bool process_rgb_matrix(uint16_t keycode, keyrecord_t *record) {
     }
 #    endif  // defined(RGB_MATRIX_KEYRELEASES)
 
-    if (last_hit_buffer.count + led_count > LED_HITS_TO_REMEMBER) {
-        memcpy(&last_hit_buffer.x[0], &last_hit_buffer.x[led_count], LED_HITS_TO_REMEMBER - led_count);
-        memcpy(&last_hit_buffer.y[0], &last_hit_buffer.y[led_count], LED_HITS_TO_REMEMBER - led_count);
-        memcpy(&last_hit_buffer.tick[0], &last_hit_buffer.tick[led_count], (LED_HITS_TO_REMEMBER - led_count) * 2);  // 16 bit
-        memcpy(&last_hit_buffer.index[0], &last_hit_buffer.index[led_count], LED_HITS_TO_REMEMBER - led_count);
-        last_hit_buffer.count--;
-    }
-
     for (uint8_t i = 0; i < led_count; i++) {
-        uint8_t index                = last_hit_buffer.count;
-        last_hit_buffer.x[index]     = g_led_config.point[led[i]].x;
-        last_hit_buffer.y[index]     = g_led_config.point[led[i]].y;
-        last_hit_buffer.index[index] = led[i];
-        last_hit_buffer.tick[index]  = 0;
-        last_hit_buffer.count++;
+        led_engine_record_hit(led[i]);
     }
 #endif  // RGB_MATRIX_KEYREACTIVE_ENABLED
 
@@ -248,145 +311,42 @@ static bool rgb_matrix_none(effect_params_t *params) {
     return led_max < DRIVER_LED_TOTAL;
 }
 
-static uint8_t         rgb_last_enable   = UINT8_MAX;
-static uint8_t         rgb_last_effect   = UINT8_MAX;
-static effect_params_t rgb_effect_params = {0, 0xFF};
-static rgb_task_states rgb_task_state    = SYNCING;
-
-static void rgb_task_timers(void) {
-    // Update double buffer timers
-    uint16_t deltaTime  = timer_elapsed32(rgb_counters_buffer);
-    rgb_counters_buffer = timer_read32();
-    if (g_rgb_counters.any_key_hit < UINT32_MAX) {
-        if (UINT32_MAX - deltaTime < g_rgb_counters.any_key_hit) {
-            g_rgb_counters.any_key_hit = UINT32_MAX;
-        } else {
-            g_rgb_counters.any_key_hit += deltaTime;
-        }
-    }
-
-    // Update double buffer last hit timers
-#ifdef RGB_MATRIX_KEYREACTIVE_ENABLED
-    uint8_t count = last_hit_buffer.count;
-    for (uint8_t i = 0; i < count; ++i) {
-        if (UINT16_MAX - deltaTime < last_hit_buffer.tick[i]) {
-            last_hit_buffer.count--;
-            continue;
-        }
-        last_hit_buffer.tick[i] += deltaTime;
-    }
-#endif  // RGB_MATRIX_KEYREACTIVE_ENABLED
-}
-
-static void rgb_task_sync(void) {
-    // next task
-    if (timer_elapsed32(g_rgb_counters.tick) >= RGB_MATRIX_LED_FLUSH_LIMIT) rgb_task_state = STARTING;
-}
-
-static void rgb_task_start(void) {
-    // reset iter
-    rgb_effect_params.iter = 0;
-
-    // update double buffers
-    g_rgb_counters.tick = rgb_counters_buffer;
-#ifdef RGB_MATRIX_KEYREACTIVE_ENABLED
-    g_last_hit_tracker = last_hit_buffer;
-#endif  // RGB_MATRIX_KEYREACTIVE_ENABLED
-
-    // next task
-    rgb_task_state = RENDERING;
-}
-
-static void rgb_task_render(uint8_t effect) {
-    bool rendering         = false;
-    rgb_effect_params.init = (effect != rgb_last_effect) || (rgb_matrix_config.enable != rgb_last_enable);
-
-    // each effect can opt to do calculations
-    // and/or request PWM buffer updates.
-    switch (effect) {
-        case RGB_MATRIX_NONE:
-            rendering = rgb_matrix_none(&rgb_effect_params);
-            break;
+// Effect descriptors in mode order, so rendering is a lookup instead of a switch
+static const rgb_matrix_effect_t rgb_matrix_effects[] PROGMEM = {
+    {rgb_matrix_none, RGB_MATRIX_EFFECT_FLAG_STATIC},
 
 // ---------------------------------------------
-// -----Begin rgb effect switch case macros-----
-#define RGB_MATRIX_EFFECT(name, ...)          \
-    case RGB_MATRIX_##name:                   \
-        rendering = name(&rgb_effect_params); \
-        break;
+// -----Begin rgb effect descriptor macros------
+#define RGB_MATRIX_EFFECT(name, ...) {name, __VA_ARGS__},
 #include "rgb_matrix_animations/rgb_matrix_effects.inc"
-#undef RGB_MATRIX_EFFECT
-
-#if defined(RGB_MATRIX_CUSTOM_KB) || defined(RGB_MATRIX_CUSTOM_USER)
-#    define RGB_MATRIX_EFFECT(name, ...)          \
-        case RGB_MATRIX_CUSTOM_##name:            \
-            rendering = name(&rgb_effect_params); \
-            break;
-#    ifdef RGB_MATRIX_CUSTOM_KB
-#        include "rgb_matrix_kb.inc"
-#    endif
-#    ifdef RGB_MATRIX_CUSTOM_USER
-#        include "rgb_matrix_user.inc"
-#    endif
-#    undef RGB_MATRIX_EFFECT
+#ifdef RGB_MATRIX_CUSTOM_KB
+#    include "rgb_matrix_kb.inc"
 #endif
-            // -----End rgb effect switch case macros-------
-            // ---------------------------------------------
-
-        // Factory default magic value
-        case UINT8_MAX: {
-            rgb_matrix_test();
-            rgb_task_state = FLUSHING;
-        }
-            return;
-    }
-
-    rgb_effect_params.iter++;
+#ifdef RGB_MATRIX_CUSTOM_USER
+#    include "rgb_matrix_user.inc"
+#endif
+#undef RGB_MATRIX_EFFECT
+    // -----End rgb effect descriptor macros--------
+    // ---------------------------------------------
+};
 
-    // next task
-    if (!rendering) {
-        rgb_task_state = FLUSHING;
-        if (!rgb_effect_params.init && effect == RGB_MATRIX_NONE) {
-            // We only need to flush once if we are RGB_MATRIX_NONE
-            rgb_task_state = SYNCING;
-        }
-    }
-}
+_Static_assert(sizeof(rgb_matrix_effects) / sizeof(rgb_matrix_effects[0]) == RGB_MATRIX_EFFECT_MAX, "rgb_matrix_effects does not match enum rgb_matrix_effects");
 
-static void rgb_task_flush(uint8_t effect) {
-    // update last trackers after the first full render so we can init over several frames
-    rgb_last_effect = effect;
-    rgb_last_enable = rgb_matrix_config.enable;
+#include "led_effect_engine.h"
 
-    // update pwm buffers
-    rgb_matrix_update_pwm_buffers();
+uint8_t rgb_matrix_get_effect_flags(uint8_t mode) { return led_engine_get_effect_flags(mode); }
 
-    // next task
-    rgb_task_state = SYNCING;
-}
+uint16_t rgb_matrix_get_effect_interval(uint8_t mode) { return led_engine_get_effect_interval(mode); }
 
 void rgb_matrix_task(void) {
-    rgb_task_timers();
+    led_task_timers();
 
     // Ideally we would also stop sending zeros to the LED driver PWM buffers
     // while suspended and just do a software shutdown. This is a cheap hack for now.
     bool    suspend_backlight = ((g_suspend_state && RGB_DISABLE_WHEN_USB_SUSPENDED) || (RGB_DISABLE_AFTER_TIMEOUT > 0 && g_rgb_counters.any_key_hit > RGB_DISABLE_AFTER_TIMEOUT * 60 * 20));
     uint8_t effect            = suspend_backlight || !rgb_matrix_config.enable ? 0 : rgb_matrix_config.mode;
 
-    switch (rgb_task_state) {
-        case STARTING:
-            rgb_task_start();
-            break;
-        case RENDERING:
-            rgb_task_render(effect);
-            break;
-        case FLUSHING:
-            rgb_task_flush(effect);
-            break;
-        case SYNCING:
-            rgb_task_sync();
-            break;
-    }
+    led_engine_task(effect);
 
     if (!suspend_backlight) {
         rgb_matrix_indicators();
@@ -402,21 +362,20 @@ __attribute__((weak)) void rgb_matrix_indicators_kb(void) {}
 
 __attribute__((weak)) void rgb_matrix_indicators_user(void) {}
 
+void rgb_matrix_refresh(void) { led_refresh_required = true; }
+
 void rgb_matrix_init(void) {
+#ifdef LED_CORRECTION_ENABLE
+    led_correction_init();
+#endif
     rgb_matrix_driver.init();
+    rgb_matrix_update_geometry();
 
     // TODO: put the 1 second startup delay here?
 
 #ifdef RGB_MATRIX_KEYREACTIVE_ENABLED
     g_last_hit_tracker.count = 0;
-    for (uint8_t i = 0; i < LED_HITS_TO_REMEMBER; ++i) {
-        g_last_hit_tracker.tick[i] = UINT16_MAX;
-    }
-
-    last_hit_buffer.count = 0;
-    for (uint8_t i = 0; i < LED_HITS_TO_REMEMBER; ++i) {
-        last_hit_buffer.tick[i] = UINT16_MAX;
-    }
+    g_last_hit_tracker.head  = 0;
 #endif  // RGB_MATRIX_KEYREACTIVE_ENABLED
 
     if (!eeconfig_is_enabled()) {
@@ -442,7 +401,7 @@ void rgb_matrix_set_suspend_state(bool state) {
 
 void rgb_matrix_toggle(void) {
     rgb_matrix_config.enable ^= 1;
-    rgb_task_state = STARTING;
+    led_task_state = STARTING;
     eeconfig_update_rgb_matrix();
 }
 
@@ -452,7 +411,7 @@ void rgb_matrix_enable(void) {
 }
 
 void rgb_matrix_enable_noeeprom(void) {
-    if (!rgb_matrix_config.enable) rgb_task_state = STARTING;
+    if (!rgb_matrix_config.enable) led_task_state = STARTING;
     rgb_matrix_config.enable = 1;
 }
 
@@ -462,21 +421,21 @@ void rgb_matrix_disable(void) {
 }
 
 void rgb_matrix_disable_noeeprom(void) {
-    if (rgb_matrix_config.enable) rgb_task_state = STARTING;
+    if (rgb_matrix_config.enable) led_task_state = STARTING;
     rgb_matrix_config.enable = 0;
 }
 
 void rgb_matrix_step(void) {
     rgb_matrix_config.mode++;
     if (rgb_matrix_config.mode >= RGB_MATRIX_EFFECT_MAX) rgb_matrix_config.mode = 1;
-    rgb_task_state = STARTING;
+    led_task_state = STARTING;
     eeconfig_update_rgb_matrix();
 }
 
 void rgb_matrix_step_reverse(void) {
     rgb_matrix_config.mode--;
     if (rgb_matrix_config.mode < 1) rgb_matrix_config.mode = RGB_MATRIX_EFFECT_MAX - 1;
-    rgb_task_state = STARTING;
+    led_task_state = STARTING;
     eeconfig_update_rgb_matrix();
 }
 
@@ -521,13 +480,13 @@ void rgb_matrix_decrease_speed(void) {
     eeconfig_update_rgb_matrix();
 }
 
-led_flags_t rgb_matrix_get_flags(void) { return rgb_effect_params.flags; }
+led_flags_t rgb_matrix_get_flags(void) { return led_effect_params.flags; }
 
-void rgb_matrix_set_flags(led_flags_t flags) { rgb_effect_params.flags = flags; }
+void rgb_matrix_set_flags(led_flags_t flags) { led_effect_params.flags = flags; }
 
 void rgb_matrix_mode(uint8_t mode) {
     rgb_matrix_config.mode = mode;
-    rgb_task_state         = STARTING;
+    led_task_state         = STARTING;
     eeconfig_update_rgb_matrix();
 }
 
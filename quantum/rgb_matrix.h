@@ -34,6 +34,8 @@
 #    include "is31fl3737.h"
 #elif defined(WS2812)
 #    include "ws2812.h"
+#elif defined(APA102)
+#    include "apa102.h"
 #endif
 
 #ifndef RGB_MATRIX_LED_FLUSH_LIMIT
@@ -41,20 +43,35 @@
 #endif
 
 #ifndef RGB_MATRIX_LED_PROCESS_LIMIT
-#    define RGB_MATRIX_LED_PROCESS_LIMIT (DRIVER_LED_TOTAL + 4) / 5
+#    ifdef RGB_MATRIX_RENDER_BUDGET
+// the budget decides how many chunks are rendered per task run, small
+// chunks let it stop close to the budget
+#        define RGB_MATRIX_LED_PROCESS_LIMIT 8
+#    else
+#        define RGB_MATRIX_LED_PROCESS_LIMIT (DRIVER_LED_TOTAL + 4) / 5
+#    endif
 #endif
 
+// Largest number of LEDs the effect runners convert from HSV at once
+#define RGB_MATRIX_FRAME_LIMIT 16
+
 #if defined(RGB_MATRIX_LED_PROCESS_LIMIT) && RGB_MATRIX_LED_PROCESS_LIMIT > 0 && RGB_MATRIX_LED_PROCESS_LIMIT < DRIVER_LED_TOTAL
 #    define RGB_MATRIX_USE_LIMITS(min, max)                        \
         uint8_t min = RGB_MATRIX_LED_PROCESS_LIMIT * params->iter; \
         uint8_t max = min + RGB_MATRIX_LED_PROCESS_LIMIT;          \
         if (max > DRIVER_LED_TOTAL) max = DRIVER_LED_TOTAL;
+#    define RGB_MATRIX_LIMITS_SIZE (RGB_MATRIX_LED_PROCESS_LIMIT)
 #else
 #    define RGB_MATRIX_USE_LIMITS(min, max) \
         uint8_t min = 0;                    \
         uint8_t max = DRIVER_LED_TOTAL;
+#    define RGB_MATRIX_LIMITS_SIZE DRIVER_LED_TOTAL
 #endif
 
+// LEDs in one frame of the effect runners, RGB_MATRIX_LIMITS_SIZE is the
+// most LEDs RGB_MATRIX_USE_LIMITS() hands to an effect in one call
+#define RGB_MATRIX_CHUNK_SIZE ((RGB_MATRIX_LIMITS_SIZE) < RGB_MATRIX_FRAME_LIMIT ? (RGB_MATRIX_LIMITS_SIZE) : RGB_MATRIX_FRAME_LIMIT)
+
 #define RGB_MATRIX_TEST_LED_FLAGS() \
     if (!HAS_ANY_FLAGS(g_led_config.flags[i], params->flags)) continue
 
@@ -100,9 +117,17 @@ void rgb_matrix_task(void);
 void rgb_matrix_indicators(void);
 void rgb_matrix_indicators_kb(void);
 void rgb_matrix_indicators_user(void);
+// Static effects are only redrawn when the config, layers, mods or host
+// LEDs change, call this when indicators depend on anything else
+void rgb_matrix_refresh(void);
 
 void rgb_matrix_init(void);
 
+uint8_t  rgb_matrix_get_effect_flags(uint8_t mode);
+uint16_t rgb_matrix_get_effect_interval(uint8_t mode);
+// Call after changing g_led_config.point at runtime
+void rgb_matrix_update_geometry(void);
+
 void        rgb_matrix_set_suspend_state(bool state);
 void        rgb_matrix_toggle(void);
 void        rgb_matrix_enable(void);
@@ -168,8 +193,11 @@ extern rgb_config_t rgb_matrix_config;
 extern bool           g_suspend_state;
 extern rgb_counters_t g_rgb_counters;
 extern led_config_t   g_led_config;
+extern led_geometry_t g_led_geometry[DRIVER_LED_TOTAL];
 #ifdef RGB_MATRIX_KEYREACTIVE_ENABLED
 extern last_hit_t g_last_hit_tracker;
+extern uint8_t    g_led_grid_start[LED_EFFECT_GRID_CELLS + 1];
+extern uint8_t    g_led_grid[DRIVER_LED_TOTAL];
 #endif
 #ifdef RGB_MATRIX_FRAMEBUFFER_EFFECTS
 extern uint8_t rgb_frame_buffer[MATRIX_ROWS][MATRIX_COLS];
@@ -60,11 +60,14 @@ static void init(void) {
 #    endif
 }
 
+#    if defined(IS31FL3731) || defined(IS31FL3733)
+// Both drivers are flushed in one pass, so their transfers interleave on the bus
+static const uint8_t driver_addrs[] = {DRIVER_ADDR_1, DRIVER_ADDR_2};
+#        define DRIVER_FLUSH_COUNT (DRIVER_COUNT > 1 ? 2 : 1)
+#    endif
+
 #    ifdef IS31FL3731
-static void flush(void) {
-    IS31FL3731_update_pwm_buffers(DRIVER_ADDR_1, 0);
-    IS31FL3731_update_pwm_buffers(DRIVER_ADDR_2, 1);
-}
+static void flush(void) { IS31FL3731_update_all_pwm_buffers(driver_addrs, DRIVER_FLUSH_COUNT); }
 
 const rgb_matrix_driver_t rgb_matrix_driver = {
     .init          = init,
@@ -73,10 +76,7 @@ const rgb_matrix_driver_t rgb_matrix_driver = {
     .set_color_all = IS31FL3731_set_color_all,
 };
 #    elif defined(IS31FL3733)
-static void flush(void) {
-    IS31FL3733_update_pwm_buffers(DRIVER_ADDR_1, 0);
-    IS31FL3733_update_pwm_buffers(DRIVER_ADDR_2, 1);
-}
+static void flush(void) { IS31FL3733_update_all_pwm_buffers(driver_addrs, DRIVER_FLUSH_COUNT); }
 
 const rgb_matrix_driver_t rgb_matrix_driver = {
     .init = init,
@@ -95,7 +95,7 @@ const rgb_matrix_driver_t rgb_matrix_driver = {
 };
 #    endif
 
-#elif defined(WS2812)
+#elif defined(WS2812) || defined(APA102)
 
 // LED color buffer
 LED_TYPE led[DRIVER_LED_TOTAL];
@@ -103,8 +103,12 @@ LED_TYPE led[DRIVER_LED_TOTAL];
 static void init(void) {}
 
 static void flush(void) {
+#    ifdef APA102
+    apa102_setleds(led, DRIVER_LED_TOTAL);
+#    else
     // Assumes use of RGB_DI_PIN
     ws2812_setleds(led, DRIVER_LED_TOTAL);
+#    endif
 }
 
 // Set an led in the buffer to a color
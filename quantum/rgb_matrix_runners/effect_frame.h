@@ -0,0 +1,27 @@
+#pragma once
+
+// The runners render the HSV values of up to RGB_MATRIX_CHUNK_SIZE LEDs into
+// this frame, then convert them in place with hsv_to_rgb_batch(). Longer
+// ranges are rendered as several frames.
+typedef union {
+    HSV hsv[RGB_MATRIX_CHUNK_SIZE];
+    RGB rgb[RGB_MATRIX_CHUNK_SIZE];
+} effect_frame_t;
+
+static effect_frame_t effect_frame;
+
+// End of the frame that starts at frame_min
+static uint8_t effect_frame_end(uint8_t frame_min, uint8_t led_max) { return led_max - frame_min > RGB_MATRIX_CHUNK_SIZE ? frame_min + RGB_MATRIX_CHUNK_SIZE : led_max; }
+
+// Converts the HSV values of led_min to led_max - 1 from hsv, which may be
+// effect_frame.hsv itself, and writes them out
+static void effect_frame_flush_from(effect_params_t* params, const HSV* hsv, uint8_t led_min, uint8_t led_max) {
+    hsv_to_rgb_batch(hsv, effect_frame.rgb, led_max - led_min);
+    for (uint8_t i = led_min; i < led_max; i++) {
+        RGB_MATRIX_TEST_LED_FLAGS();
+        RGB rgb = effect_frame.rgb[i - led_min];
+        rgb_matrix_set_color(i, rgb.r, rgb.g, rgb.b);
+    }
+}
+
+static void effect_frame_flush(effect_params_t* params, uint8_t led_min, uint8_t led_max) { effect_frame_flush_from(params, effect_frame.hsv, led_min, led_max); }
@@ -0,0 +1,18 @@
+#pragma once
+
+typedef HSV (*dist_angle_f)(HSV hsv, uint8_t dist, uint8_t angle, uint8_t time);
+
+bool effect_runner_dist_angle(effect_params_t* params, dist_angle_f effect_func) {
+    RGB_MATRIX_USE_LIMITS(led_min, led_max);
+
+    uint8_t time = scale16by8(g_rgb_counters.tick, rgb_matrix_config.speed / 2);
+    for (uint8_t frame_min = led_min, frame_max; frame_min < led_max; frame_min = frame_max) {
+        frame_max = effect_frame_end(frame_min, led_max);
+        for (uint8_t i = frame_min; i < frame_max; i++) {
+            RGB_MATRIX_TEST_LED_FLAGS();
+            effect_frame.hsv[i - frame_min] = effect_func(rgb_matrix_config.hsv, g_led_geometry[i].dist, g_led_geometry[i].angle, time);
+        }
+        effect_frame_flush(params, frame_min, frame_max);
+    }
+    return led_max < DRIVER_LED_TOTAL;
+}
@@ -8,20 +8,24 @@ bool effect_runner_reactive(effect_params_t* params, reactive_f effect_func) {
     RGB_MATRIX_USE_LIMITS(led_min, led_max);
 
     uint16_t max_tick = 65535 / rgb_matrix_config.speed;
-    for (uint8_t i = led_min; i < led_max; i++) {
-        RGB_MATRIX_TEST_LED_FLAGS();
-        uint16_t tick = max_tick;
-        // Reverse search to find most recent key hit
-        for (int8_t j = g_last_hit_tracker.count - 1; j >= 0; j--) {
-            if (g_last_hit_tracker.index[j] == i && g_last_hit_tracker.tick[j] < tick) {
-                tick = g_last_hit_tracker.tick[j];
-                break;
+    for (uint8_t frame_min = led_min, frame_max; frame_min < led_max; frame_min = frame_max) {
+        frame_max = effect_frame_end(frame_min, led_max);
+        for (uint8_t i = frame_min; i < frame_max; i++) {
+            RGB_MATRIX_TEST_LED_FLAGS();
+            uint16_t tick = max_tick;
+            // Reverse search to find most recent key hit
+            for (int8_t j = g_last_hit_tracker.count - 1; j >= 0; j--) {
+                uint8_t slot = last_hit_slot(j);
+                if (g_last_hit_tracker.index[slot] == i && last_hit_age(slot) < tick) {
+                    tick = last_hit_age(slot);
+                    break;
+                }
             }
-        }
 
-        uint16_t offset = scale16by8(tick, rgb_matrix_config.speed);
-        RGB      rgb    = hsv_to_rgb(effect_func(rgb_matrix_config.hsv, offset));
-        rgb_matrix_set_color(i, rgb.r, rgb.g, rgb.b);
+            uint16_t offset                 = scale16by8(tick, rgb_matrix_config.speed);
+            effect_frame.hsv[i - frame_min] = effect_func(rgb_matrix_config.hsv, offset);
+        }
+        effect_frame_flush(params, frame_min, frame_max);
     }
     return led_max < DRIVER_LED_TOTAL;
 }
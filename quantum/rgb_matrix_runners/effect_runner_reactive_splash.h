@@ -4,24 +4,74 @@
 
 typedef HSV (*reactive_splash_f)(HSV hsv, int16_t dx, int16_t dy, uint8_t dist, uint16_t tick);
 
+// For its first 255 ticks a hit may light any LED. After that it only
+// reaches the ring of LEDs with tick - 255 < dist <= tick, so only the grid
+// cells that ring passes through are visited.
+static bool effect_runner_cell_in_ring(uint8_t cell, uint8_t x, uint8_t y, uint16_t inner, uint16_t outer) {
+    uint8_t  left   = (cell % LED_EFFECT_GRID_SIZE) << LED_EFFECT_GRID_SHIFT;
+    uint8_t  top    = (cell / LED_EFFECT_GRID_SIZE) << LED_EFFECT_GRID_SHIFT;
+    uint8_t  right  = left + (1 << LED_EFFECT_GRID_SHIFT) - 1;
+    uint8_t  bottom = top + (1 << LED_EFFECT_GRID_SHIFT) - 1;
+    uint16_t near_x = x < left ? left - x : (x > right ? x - right : 0);
+    uint16_t near_y = y < top ? top - y : (y > bottom ? y - bottom : 0);
+    uint16_t far_x  = abs(x - left) > abs(x - right) ? abs(x - left) : abs(x - right);
+    uint16_t far_y  = abs(y - top) > abs(y - bottom) ? abs(y - top) : abs(y - bottom);
+
+    return (uint32_t)near_x * near_x + (uint32_t)near_y * near_y <= (uint32_t)outer * outer && (uint32_t)far_x * far_x + (uint32_t)far_y * far_y >= (uint32_t)inner * inner;
+}
+
+// The hits add up per LED, so the whole range is accumulated before it is
+// converted one frame at a time
+static HSV effect_splash_frame[RGB_MATRIX_LIMITS_SIZE];
+
 bool effect_runner_reactive_splash(uint8_t start, effect_params_t* params, reactive_splash_f effect_func) {
     RGB_MATRIX_USE_LIMITS(led_min, led_max);
 
-    uint8_t count = g_last_hit_tracker.count;
+    HSV hsv = rgb_matrix_config.hsv;
+    hsv.v   = 0;
     for (uint8_t i = led_min; i < led_max; i++) {
-        RGB_MATRIX_TEST_LED_FLAGS();
-        HSV hsv = rgb_matrix_config.hsv;
-        hsv.v   = 0;
-        for (uint8_t j = start; j < count; j++) {
-            int16_t  dx   = g_led_config.point[i].x - g_last_hit_tracker.x[j];
-            int16_t  dy   = g_led_config.point[i].y - g_last_hit_tracker.y[j];
-            uint8_t  dist = sqrt16(dx * dx + dy * dy);
-            uint16_t tick = scale16by8(g_last_hit_tracker.tick[j], rgb_matrix_config.speed);
-            hsv           = effect_func(hsv, dx, dy, dist, tick);
+        effect_splash_frame[i - led_min] = hsv;
+    }
+
+    uint8_t count = g_last_hit_tracker.count;
+    for (uint8_t j = start; j < count; j++) {
+        uint8_t  slot  = last_hit_slot(j);
+        uint8_t  x     = g_last_hit_tracker.x[slot];
+        uint8_t  y     = g_last_hit_tracker.y[slot];
+        uint16_t tick  = scale16by8(last_hit_age(slot), rgb_matrix_config.speed);
+        uint16_t inner = tick > UINT8_MAX ? tick - UINT8_MAX + 1 : 0;
+        uint16_t outer = tick > UINT8_MAX ? tick : UINT8_MAX;
+        if (inner > UINT8_MAX) continue;
+
+        uint8_t col_min = (x > outer ? x - outer : 0) >> LED_EFFECT_GRID_SHIFT;
+        uint8_t col_max = (x + outer > UINT8_MAX ? UINT8_MAX : x + outer) >> LED_EFFECT_GRID_SHIFT;
+        uint8_t row_min = (y > outer ? y - outer : 0) >> LED_EFFECT_GRID_SHIFT;
+        uint8_t row_max = (y + outer > UINT8_MAX ? UINT8_MAX : y + outer) >> LED_EFFECT_GRID_SHIFT;
+        for (uint8_t row = row_min; row <= row_max; row++) {
+            for (uint8_t col = col_min; col <= col_max; col++) {
+                uint8_t cell = row * LED_EFFECT_GRID_SIZE + col;
+                if (g_led_grid_start[cell] == g_led_grid_start[cell + 1] || !effect_runner_cell_in_ring(cell, x, y, inner, outer)) continue;
+
+                for (uint8_t k = g_led_grid_start[cell]; k < g_led_grid_start[cell + 1]; k++) {
+                    uint8_t i = g_led_grid[k];
+                    if (i < led_min || i >= led_max) continue;
+                    RGB_MATRIX_TEST_LED_FLAGS();
+                    int16_t dx   = g_led_config.point[i].x - x;
+                    int16_t dy   = g_led_config.point[i].y - y;
+                    uint8_t dist = sqrt16(dx * dx + dy * dy);
+                    if (dist < inner || dist > outer) continue;
+                    effect_splash_frame[i - led_min] = effect_func(effect_splash_frame[i - led_min], dx, dy, dist, tick);
+                }
+            }
         }
-        hsv.v   = scale8(hsv.v, rgb_matrix_config.hsv.v);
-        RGB rgb = hsv_to_rgb(hsv);
-        rgb_matrix_set_color(i, rgb.r, rgb.g, rgb.b);
+    }
+
+    for (uint8_t i = led_min; i < led_max; i++) {
+        effect_splash_frame[i - led_min].v = scale8(effect_splash_frame[i - led_min].v, rgb_matrix_config.hsv.v);
+    }
+    for (uint8_t frame_min = led_min, frame_max; frame_min < led_max; frame_min = frame_max) {
+        frame_max = effect_frame_end(frame_min, led_max);
+        effect_frame_flush_from(params, &effect_splash_frame[frame_min - led_min], frame_min, frame_max);
     }
     return led_max < DRIVER_LED_TOTAL;
 }
@@ -4,11 +4,7 @@
 #include <stdbool.h>
 #include "color.h"
 
-#if defined(__GNUC__)
-#    define PACKED __attribute__((__packed__))
-#else
-#    define PACKED
-#endif
+#include "led_effect_types.h"
 
 #if defined(_MSC_VER)
 #    pragma pack(push, 1)
@@ -18,53 +14,25 @@
 #    define RGB_MATRIX_KEYREACTIVE_ENABLED
 #endif
 
-// Last led hit
-#ifndef LED_HITS_TO_REMEMBER
-#    define LED_HITS_TO_REMEMBER 8
-#endif  // LED_HITS_TO_REMEMBER
-
-#ifdef RGB_MATRIX_KEYREACTIVE_ENABLED
-typedef struct PACKED {
-    uint8_t  count;
-    uint8_t  x[LED_HITS_TO_REMEMBER];
-    uint8_t  y[LED_HITS_TO_REMEMBER];
-    uint8_t  index[LED_HITS_TO_REMEMBER];
-    uint16_t tick[LED_HITS_TO_REMEMBER];
-} last_hit_t;
-#endif  // RGB_MATRIX_KEYREACTIVE_ENABLED
-
-typedef enum rgb_task_states { STARTING, RENDERING, FLUSHING, SYNCING } rgb_task_states;
+typedef led_task_states rgb_task_states;
 
-typedef uint8_t led_flags_t;
-
-typedef struct PACKED {
-    uint8_t     iter;
-    led_flags_t flags;
-    bool        init;
-} effect_params_t;
-
-typedef struct PACKED {
-    // Global tick at 20 Hz
-    uint32_t tick;
-    // Ticks since this key was last hit.
-    uint32_t any_key_hit;
-} rgb_counters_t;
+typedef led_counters_t rgb_counters_t;
 
+// Position of an LED relative to the matrix center, see g_led_geometry
 typedef struct PACKED {
-    uint8_t x;
-    uint8_t y;
-} point_t;
+    uint8_t dist;
+    uint8_t angle;
+} led_geometry_t;
 
-#define HAS_FLAGS(bits, flags) ((bits & flags) == flags)
-#define HAS_ANY_FLAGS(bits, flags) ((bits & flags) != 0x00)
+typedef led_effect_f rgb_matrix_effect_f;
 
-#define LED_FLAG_ALL 0xFF
-#define LED_FLAG_NONE 0x00
-#define LED_FLAG_MODIFIER 0x01
-#define LED_FLAG_UNDERGLOW 0x02
-#define LED_FLAG_KEYLIGHT 0x04
+#define RGB_MATRIX_EFFECT_FLAG_NONE LED_EFFECT_FLAG_NONE
+#define RGB_MATRIX_EFFECT_FLAG_STATIC LED_EFFECT_FLAG_STATIC            // frame only depends on rgb_matrix_config
+#define RGB_MATRIX_EFFECT_FLAG_REACTIVE LED_EFFECT_FLAG_REACTIVE        // reads g_last_hit_tracker
+#define RGB_MATRIX_EFFECT_FLAG_FRAMEBUFFER LED_EFFECT_FLAG_FRAMEBUFFER  // reads rgb_frame_buffer
 
-#define NO_LED 255
+// Built from the optional arguments of RGB_MATRIX_EFFECT(name, flags, interval)
+typedef led_effect_t rgb_matrix_effect_t;
 
 typedef struct PACKED {
     uint8_t matrix_co[MATRIX_ROWS][MATRIX_COLS];
@@ -26,13 +26,18 @@
 #    include "hal.h"
 #    include "eeprom_stm32.h"
 #endif
-#include "wait.h"
 #include "progmem.h"
 #include "timer.h"
 #include "rgblight.h"
 #include "color.h"
 #include "debug.h"
 #include "led_tables.h"
+#ifdef LED_CORRECTION_ENABLE
+#    include "led_correction.h"
+#endif
+#ifdef LED_POWER_LIMIT_ENABLE
+#    include "led_power.h"
+#endif
 #include "lib/lib8tion/lib8tion.h"
 #ifdef VELOCIKEY_ENABLE
 #    include "velocikey.h"
@@ -41,6 +46,9 @@
 #ifndef MIN
 #    define MIN(a, b) (((a) < (b)) ? (a) : (b))
 #endif
+#ifndef MAX
+#    define MAX(a, b) (((a) > (b)) ? (a) : (b))
+#endif
 
 #ifdef RGBLIGHT_SPLIT
 /* for split keyboard */
@@ -105,6 +113,14 @@ LED_TYPE led[RGBLED_NUM];
 
 #ifdef RGBLIGHT_LAYERS
 rgblight_segment_t const *const *rgblight_layers = NULL;
+
+// The enabled layers converted to RGB, rebuilt only when the layer list or
+// the enabled layers change
+#    define RGBLIGHT_BLEND_UNCOVERED 0xFF
+static LED_TYPE                          layers_frame[RGBLED_NUM];
+static uint8_t                           layers_blend[RGBLED_NUM];
+static rgblight_segment_t const *const *layers_cached_list = NULL;
+static uint8_t                           layers_cached_mask;
 #endif
 
 static uint8_t clipping_start_pos = 0;
@@ -203,6 +219,10 @@ void rgblight_init(void) {
         return;
     }
 
+#ifdef LED_CORRECTION_ENABLE
+    led_correction_init();
+#endif
+
     dprintf("rgblight_init called.\n");
     dprintf("rgblight_init start!\n");
     if (!eeconfig_is_enabled()) {
@@ -358,7 +378,6 @@ void rgblight_disable(void) {
     dprintf("rgblight disable [EEPROM]: rgblight_config.enable = %u\n", rgblight_config.enable);
     rgblight_timer_disable();
     RGBLIGHT_SPLIT_SET_CHANGE_MODE;
-    wait_ms(50);
     rgblight_set();
 }
 
@@ -367,7 +386,6 @@ void rgblight_disable_noeeprom(void) {
     dprintf("rgblight disable [NOEEPROM]: rgblight_config.enable = %u\n", rgblight_config.enable);
     rgblight_timer_disable();
     RGBLIGHT_SPLIT_SET_CHANGE_MODE;
-    wait_ms(50);
     rgblight_set();
 }
 
@@ -591,7 +609,6 @@ void rgblight_setrgb_range(uint8_t r, uint8_t g, uint8_t b, uint8_t start, uint8
 #endif
     }
     rgblight_set();
-    wait_ms(1);
 }
 
 void rgblight_sethsv_range(uint8_t hue, uint8_t sat, uint8_t val, uint8_t start, uint8_t end) {
@@ -625,7 +642,7 @@ void rgblight_set_layer_state(uint8_t layer, bool enabled) {
     RGBLIGHT_SPLIT_SET_CHANGE_LAYERS;
     // Static modes don't have a ticker running to update the LEDs
     if (rgblight_status.timer_enabled == false) {
-        rgblight_mode_noeeprom(rgblight_config.mode);
+        rgblight_set();
     }
 }
 
@@ -634,8 +651,33 @@ bool rgblight_get_layer_state(uint8_t layer) {
     return (rgblight_status.enabled_layer_mask & mask) != 0;
 }
 
-// Write any enabled LED layers into the buffer
-static void rgblight_layers_write(void) {
+static void rgblight_blend(LED_TYPE *below, const LED_TYPE *above, uint8_t mode) {
+    switch (mode) {
+        case RGBLIGHT_BLEND_ADD:
+            below->r = qadd8(below->r, above->r);
+            below->g = qadd8(below->g, above->g);
+            below->b = qadd8(below->b, above->b);
+            break;
+        case RGBLIGHT_BLEND_LIGHTEN:
+            below->r = MAX(below->r, above->r);
+            below->g = MAX(below->g, above->g);
+            below->b = MAX(below->b, above->b);
+            break;
+        default:
+            *below = *above;
+            break;
+    }
+}
+
+// Convert the enabled LED layers into the layer cache
+static void rgblight_layers_update(void) {
+    if (layers_cached_list == rgblight_layers && layers_cached_mask == rgblight_status.enabled_layer_mask) {
+        return;
+    }
+    layers_cached_list = rgblight_layers;
+    layers_cached_mask = rgblight_status.enabled_layer_mask;
+    memset(layers_blend, RGBLIGHT_BLEND_UNCOVERED, sizeof(layers_blend));
+
     uint8_t i = 0;
     // For each layer
     for (const rgblight_segment_t *const *layer_ptr = rgblight_layers; i < RGBLIGHT_MAX_LAYERS; layer_ptr++, i++) {
@@ -654,9 +696,21 @@ static void rgblight_layers_write(void) {
                 break;  // No more segments
             }
             // Write segment.count LEDs
-            LED_TYPE *const limit = &led[MIN(segment.index + segment.count, RGBLED_NUM)];
-            for (LED_TYPE *led_ptr = &led[segment.index]; led_ptr < limit; led_ptr++) {
-                sethsv(segment.hue, segment.sat, segment.val, led_ptr);
+            LED_TYPE color;
+            sethsv(segment.hue, segment.sat, segment.val, &color);
+            uint8_t limit = MIN(segment.index + segment.count, RGBLED_NUM);
+            for (uint8_t j = segment.index; j < limit; j++) {
+                if (segment.blend == RGBLIGHT_BLEND_REPLACE || layers_blend[j] == RGBLIGHT_BLEND_UNCOVERED) {
+                    layers_frame[j] = color;
+                    layers_blend[j] = segment.blend;
+                } else {
+                    // Blended over a lower layer: the two combine here, and
+                    // still replace the animation if the lower one did
+                    rgblight_blend(&layers_frame[j], &color, segment.blend);
+                    if (layers_blend[j] != RGBLIGHT_BLEND_REPLACE) {
+                        layers_blend[j] = segment.blend;
+                    }
+                }
             }
             segment_ptr++;
         }
@@ -670,8 +724,9 @@ void rgblight_set(void) {
     uint16_t  num_leds = clipping_num_leds;
 
 #    ifdef RGBLIGHT_LAYERS
-    if (rgblight_layers != NULL) {
-        rgblight_layers_write();
+    bool layers_visible = rgblight_layers != NULL && rgblight_status.enabled_layer_mask;
+    if (layers_visible) {
+        rgblight_layers_update();
     }
 #    endif
 
@@ -686,10 +741,33 @@ void rgblight_set(void) {
         }
     }
 
-#    ifdef RGBLIGHT_LED_MAP
+#    if defined(RGBLIGHT_LED_MAP) || defined(LED_CORRECTION_ENABLE) || defined(RGBLIGHT_LAYERS)
+    // layers and corrections are only applied to what is sent, led[] keeps what the effects set
     LED_TYPE led0[RGBLED_NUM];
+#        ifdef LED_POWER_LIMIT_ENABLE
+    uint32_t power_sum = 0;
+#        endif
     for (uint8_t i = 0; i < RGBLED_NUM; i++) {
-        led0[i] = led[pgm_read_byte(&led_map[i])];
+#        ifdef RGBLIGHT_LED_MAP
+        uint8_t src = pgm_read_byte(&led_map[i]);
+#        else
+        uint8_t src = i;
+#        endif
+        led0[i] = led[src];
+#        ifdef RGBLIGHT_LAYERS
+        // layers stay hidden on the effect range while rgblight is disabled
+        if (layers_visible && layers_blend[src] != RGBLIGHT_BLEND_UNCOVERED && (rgblight_config.enable || src < effect_start_pos || src >= effect_end_pos)) {
+            rgblight_blend(&led0[i], &layers_frame[src], layers_blend[src]);
+        }
+#        endif
+#        ifdef LED_CORRECTION_ENABLE
+        led_correction_apply(&led0[i].r, &led0[i].g, &led0[i].b);
+#        endif
+#        ifdef LED_POWER_LIMIT_ENABLE
+        if (i >= clipping_start_pos && i < clipping_start_pos + num_leds) {
+            power_sum += led0[i].r + led0[i].g + led0[i].b;
+        }
+#        endif
     }
     start_led = led0 + clipping_start_pos;
 #    else
@@ -701,7 +779,21 @@ void rgblight_set(void) {
         convert_rgb_to_rgbw(&start_led[i]);
     }
 #    endif
+#    ifdef RGBLIGHT_DRIVER_APA102
+    apa102_setleds(start_led, num_leds);
+#    else
     ws2812_setleds(start_led, num_leds);
+#    endif
+
+#    ifdef LED_POWER_LIMIT_ENABLE
+    // static modes are not set again, so send them at the new scale now
+    static bool power_resend = false;
+    if (led_power_limit(power_sum, num_leds) && !power_resend) {
+        power_resend = true;
+        rgblight_set();
+        power_resend = false;
+    }
+#    endif
 }
 #endif
 
@@ -817,100 +909,116 @@ static void rgblight_effect_dummy(animation_status_t *anim) {
     **/
 }
 
-void rgblight_task(void) {
-    if (rgblight_status.timer_enabled) {
-        effect_func_t effect_func   = rgblight_effect_dummy;
-        uint16_t      interval_time = 2000;  // dummy interval
-        uint8_t       delta         = rgblight_config.mode - rgblight_status.base_mode;
-        animation_status.delta      = delta;
+// Look up the step function of the current mode, and the time until its next step
+static effect_func_t rgblight_effect_lookup(uint16_t *interval) {
+    effect_func_t effect_func   = rgblight_effect_dummy;
+    uint16_t      interval_time = 2000;  // dummy interval
+    uint8_t       delta         = rgblight_config.mode - rgblight_status.base_mode;
+    animation_status.delta      = delta;
 
-        // static light mode, do nothing here
-        if (1 == 0) {  // dummy
-        }
+    // static light mode, do nothing here
+    if (1 == 0) {  // dummy
+    }
 #    ifdef RGBLIGHT_EFFECT_BREATHING
-        else if (rgblight_status.base_mode == RGBLIGHT_MODE_BREATHING) {
-            // breathing mode
-            interval_time = get_interval_time(&RGBLED_BREATHING_INTERVALS[delta], 1, 100);
-            effect_func   = rgblight_effect_breathing;
-        }
+    else if (rgblight_status.base_mode == RGBLIGHT_MODE_BREATHING) {
+        // breathing mode
+        interval_time = get_interval_time(&RGBLED_BREATHING_INTERVALS[delta], 1, 100);
+        effect_func   = rgblight_effect_breathing;
+    }
 #    endif
 #    ifdef RGBLIGHT_EFFECT_RAINBOW_MOOD
-        else if (rgblight_status.base_mode == RGBLIGHT_MODE_RAINBOW_MOOD) {
-            // rainbow mood mode
-            interval_time = get_interval_time(&RGBLED_RAINBOW_MOOD_INTERVALS[delta], 5, 100);
-            effect_func   = rgblight_effect_rainbow_mood;
-        }
+    else if (rgblight_status.base_mode == RGBLIGHT_MODE_RAINBOW_MOOD) {
+        // rainbow mood mode
+        interval_time = get_interval_time(&RGBLED_RAINBOW_MOOD_INTERVALS[delta], 5, 100);
+        effect_func   = rgblight_effect_rainbow_mood;
+    }
 #    endif
 #    ifdef RGBLIGHT_EFFECT_RAINBOW_SWIRL
-        else if (rgblight_status.base_mode == RGBLIGHT_MODE_RAINBOW_SWIRL) {
-            // rainbow swirl mode
-            interval_time = get_interval_time(&RGBLED_RAINBOW_SWIRL_INTERVALS[delta / 2], 1, 100);
-            effect_func   = rgblight_effect_rainbow_swirl;
-        }
+    else if (rgblight_status.base_mode == RGBLIGHT_MODE_RAINBOW_SWIRL) {
+        // rainbow swirl mode
+        interval_time = get_interval_time(&RGBLED_RAINBOW_SWIRL_INTERVALS[delta / 2], 1, 100);
+        effect_func   = rgblight_effect_rainbow_swirl;
+    }
 #    endif
 #    ifdef RGBLIGHT_EFFECT_SNAKE
-        else if (rgblight_status.base_mode == RGBLIGHT_MODE_SNAKE) {
-            // snake mode
-            interval_time = get_interval_time(&RGBLED_SNAKE_INTERVALS[delta / 2], 1, 200);
-            effect_func   = rgblight_effect_snake;
-        }
+    else if (rgblight_status.base_mode == RGBLIGHT_MODE_SNAKE) {
+        // snake mode
+        interval_time = get_interval_time(&RGBLED_SNAKE_INTERVALS[delta / 2], 1, 200);
+        effect_func   = rgblight_effect_snake;
+    }
 #    endif
 #    ifdef RGBLIGHT_EFFECT_KNIGHT
-        else if (rgblight_status.base_mode == RGBLIGHT_MODE_KNIGHT) {
-            // knight mode
-            interval_time = get_interval_time(&RGBLED_KNIGHT_INTERVALS[delta], 5, 100);
-            effect_func   = rgblight_effect_knight;
-        }
+    else if (rgblight_status.base_mode == RGBLIGHT_MODE_KNIGHT) {
+        // knight mode
+        interval_time = get_interval_time(&RGBLED_KNIGHT_INTERVALS[delta], 5, 100);
+        effect_func   = rgblight_effect_knight;
+    }
 #    endif
 #    ifdef RGBLIGHT_EFFECT_CHRISTMAS
-        else if (rgblight_status.base_mode == RGBLIGHT_MODE_CHRISTMAS) {
-            // christmas mode
-            interval_time = RGBLIGHT_EFFECT_CHRISTMAS_INTERVAL;
-            effect_func   = (effect_func_t)rgblight_effect_christmas;
-        }
+    else if (rgblight_status.base_mode == RGBLIGHT_MODE_CHRISTMAS) {
+        // christmas mode
+        interval_time = RGBLIGHT_EFFECT_CHRISTMAS_INTERVAL;
+        effect_func   = (effect_func_t)rgblight_effect_christmas;
+    }
 #    endif
 #    ifdef RGBLIGHT_EFFECT_RGB_TEST
-        else if (rgblight_status.base_mode == RGBLIGHT_MODE_RGB_TEST) {
-            // RGB test mode
-            interval_time = pgm_read_word(&RGBLED_RGBTEST_INTERVALS[0]);
-            effect_func   = (effect_func_t)rgblight_effect_rgbtest;
-        }
+    else if (rgblight_status.base_mode == RGBLIGHT_MODE_RGB_TEST) {
+        // RGB test mode
+        interval_time = pgm_read_word(&RGBLED_RGBTEST_INTERVALS[0]);
+        effect_func   = (effect_func_t)rgblight_effect_rgbtest;
+    }
 #    endif
 #    ifdef RGBLIGHT_EFFECT_ALTERNATING
-        else if (rgblight_status.base_mode == RGBLIGHT_MODE_ALTERNATING) {
-            interval_time = 500;
-            effect_func   = (effect_func_t)rgblight_effect_alternating;
-        }
+    else if (rgblight_status.base_mode == RGBLIGHT_MODE_ALTERNATING) {
+        interval_time = 500;
+        effect_func   = (effect_func_t)rgblight_effect_alternating;
+    }
 #    endif
-        if (animation_status.restart) {
-            animation_status.restart    = false;
-            animation_status.last_timer = timer_read() - interval_time - 1;
-            animation_status.pos16      = 0;  // restart signal to local each effect
-        }
-        if (timer_elapsed(animation_status.last_timer) >= interval_time) {
+    *interval = interval_time;
+    return effect_func;
+}
+
+void rgblight_task(void) {
+    if (!rgblight_status.timer_enabled) {
+        return;
+    }
+    if (animation_status.restart) {
+        animation_status.restart    = false;
+        animation_status.last_timer = timer_read();
+        animation_status.interval   = 0;  // step right away
+        animation_status.pos16      = 0;  // restart signal to local each effect
+    }
+    // Nothing to do until the next step is due
+    if (!timer_expired(timer_read(), animation_status.last_timer + animation_status.interval)) {
+        return;
+    }
+
+    // The mode is only resolved when a step is due, and also gives the
+    // deadline of the step after it
+    uint16_t      interval;
+    effect_func_t effect_func = rgblight_effect_lookup(&interval);
 #    if defined(RGBLIGHT_SPLIT) && !defined(RGBLIGHT_SPLIT_NO_ANIMATION_SYNC)
-            static uint16_t report_last_timer = 0;
-            static bool     tick_flag         = false;
-            uint16_t        oldpos16;
-            if (tick_flag) {
-                tick_flag = false;
-                if (timer_elapsed(report_last_timer) >= 30000) {
-                    report_last_timer = timer_read();
-                    dprintf("rgblight animation tick report to slave\n");
-                    RGBLIGHT_SPLIT_ANIMATION_TICK;
-                }
-            }
-            oldpos16 = animation_status.pos16;
+    static uint16_t report_last_timer = 0;
+    static bool     tick_flag         = false;
+    uint16_t        oldpos16;
+    if (tick_flag) {
+        tick_flag = false;
+        if (timer_elapsed(report_last_timer) >= 30000) {
+            report_last_timer = timer_read();
+            dprintf("rgblight animation tick report to slave\n");
+            RGBLIGHT_SPLIT_ANIMATION_TICK;
+        }
+    }
+    oldpos16 = animation_status.pos16;
 #    endif
-            animation_status.last_timer += interval_time;
-            effect_func(&animation_status);
+    animation_status.last_timer += animation_status.interval;
+    animation_status.interval = interval;
+    effect_func(&animation_status);
 #    if defined(RGBLIGHT_SPLIT) && !defined(RGBLIGHT_SPLIT_NO_ANIMATION_SYNC)
-            if (animation_status.pos16 == 0 && oldpos16 != 0) {
-                tick_flag = true;
-            }
-#    endif
-        }
+    if (animation_status.pos16 == 0 && oldpos16 != 0) {
+        tick_flag = true;
     }
+#    endif
 }
 
 #endif /* RGBLIGHT_USE_TIMER */
@@ -160,7 +160,9 @@ enum RGBLIGHT_EFFECT_MODE {
 #    include <stdint.h>
 #    include <stdbool.h>
 #    include "eeconfig.h"
-#    ifndef RGBLIGHT_CUSTOM_DRIVER
+#    ifdef RGBLIGHT_DRIVER_APA102
+#        include "apa102.h"
+#    elif !defined(RGBLIGHT_CUSTOM_DRIVER)
 #        include "ws2812.h"
 #    endif
 #    include "color.h"
@@ -171,12 +173,20 @@ enum RGBLIGHT_EFFECT_MODE {
 #    endif
 
 #    ifdef RGBLIGHT_LAYERS
+// How a segment combines with the animation and the layers below it
+enum rgblight_blend_mode {
+    RGBLIGHT_BLEND_REPLACE = 0,  // Segment color replaces what is below
+    RGBLIGHT_BLEND_ADD,          // Channels are added, saturating at 255
+    RGBLIGHT_BLEND_LIGHTEN,      // Brighter value of each channel
+};
+
 typedef struct {
     uint8_t index;  // The first LED to light
     uint8_t count;  // The number of LEDs to light
     uint8_t hue;
     uint8_t sat;
     uint8_t val;
+    uint8_t blend;  // One of rgblight_blend_mode, defaults to replace
 } rgblight_segment_t;
 
 #        define RGBLIGHT_END_SEGMENT_INDEX (255)
@@ -361,6 +371,7 @@ void rgblight_update_sync(rgblight_syncinfo_t *syncinfo, bool write_to_eeprom);
 
 typedef struct _animation_status_t {
     uint16_t last_timer;
+    uint16_t interval; /* time from last_timer to the next step */
     uint8_t  delta; /* mode - base_mode */
     bool     restart;
     union {
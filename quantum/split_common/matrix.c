@@ -30,7 +30,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define ERROR_DISCONNECT_COUNT 5
 
-#define ROWS_PER_HAND (MATRIX_ROWS / 2)
+#ifdef SPLIT_TRANSPORT_NODES
+// each node scans its own share of the rows
+static uint8_t rows_per_hand;
+#    define ROWS_PER_HAND rows_per_hand
+#else
+#    define ROWS_PER_HAND (MATRIX_ROWS / 2)
+#endif
 
 #ifdef DIRECT_PINS
 static pin_t direct_pins[MATRIX_ROWS][MATRIX_COLS] = DIRECT_PINS;
@@ -216,8 +222,13 @@ void matrix_init(void) {
 #endif
     }
 
+#ifdef SPLIT_TRANSPORT_NODES
+    rows_per_hand = split_node_row_count(split_node_index());
+    thisHand      = split_node_row_offset(split_node_index());
+#else
     thisHand = isLeftHand ? 0 : (ROWS_PER_HAND);
     thatHand = ROWS_PER_HAND - thisHand;
+#endif
 
     // initialize key pins
     init_pins();
@@ -237,6 +248,10 @@ void matrix_init(void) {
 
 void matrix_post_scan(void) {
     if (is_keyboard_master()) {
+#ifdef SPLIT_TRANSPORT_NODES
+        // disconnected nodes are handled per node by the transport
+        transport_master(matrix);
+#else
         static uint8_t error_count;
 
         if (!transport_master(matrix + thatHand)) {
@@ -251,6 +266,7 @@ void matrix_post_scan(void) {
         } else {
             error_count = 0;
         }
+#endif
 
         matrix_scan_quantum();
     } else {
@@ -0,0 +1,44 @@
+#include "matrix_pack.h"
+
+// Needs to hold a full row plus the up to 7 bits left over from the previous one
+#if (MATRIX_COLS > 24)
+typedef uint64_t pack_acc_t;
+#else
+typedef uint32_t pack_acc_t;
+#endif
+
+void split_matrix_pack(uint8_t *packed, const matrix_row_t matrix[], uint8_t rows, uint8_t cols) {
+    pack_acc_t mask  = ((pack_acc_t)1 << cols) - 1;
+    pack_acc_t acc   = 0;
+    uint8_t    nbits = 0;
+
+    for (uint8_t row = 0; row < rows; row++) {
+        acc |= ((pack_acc_t)matrix[row] & mask) << nbits;
+        nbits += cols;
+        while (nbits >= 8) {
+            *packed++ = acc & 0xFF;
+            acc >>= 8;
+            nbits -= 8;
+        }
+    }
+
+    if (nbits) {
+        *packed = acc & 0xFF;
+    }
+}
+
+void split_matrix_unpack(matrix_row_t matrix[], const uint8_t *packed, uint8_t rows, uint8_t cols) {
+    pack_acc_t mask  = ((pack_acc_t)1 << cols) - 1;
+    pack_acc_t acc   = 0;
+    uint8_t    nbits = 0;
+
+    for (uint8_t row = 0; row < rows; row++) {
+        while (nbits < cols) {
+            acc |= (pack_acc_t)*packed++ << nbits;
+            nbits += 8;
+        }
+        matrix[row] = acc & mask;
+        acc >>= cols;
+        nbits -= cols;
+    }
+}
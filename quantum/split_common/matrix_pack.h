@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stdint.h>
+#include "matrix.h"
+
+// Number of bytes needed to hold rows * cols key states, one bit per key
+#define SPLIT_PACKED_MATRIX_SIZE(rows, cols) (((rows) * (cols) + 7) / 8)
+
+// Packs the lowest cols bits of each of rows matrix rows back to back into packed.
+void split_matrix_pack(uint8_t *packed, const matrix_row_t matrix[], uint8_t rows, uint8_t cols);
+// Reverses split_matrix_pack.
+void split_matrix_unpack(matrix_row_t matrix[], const uint8_t *packed, uint8_t rows, uint8_t cols);
@@ -0,0 +1,24 @@
+#include "split_frame.h"
+
+// CRC-8, polynomial x^8 + x^2 + x + 1, seeded with 0xFF so that an all zero
+// buffer is not a valid frame. Computed bitwise, frames are only a few bytes
+// long and a lookup table would cost 256 bytes of flash.
+uint8_t split_crc8(const uint8_t *data, uint8_t size) {
+    uint8_t crc = 0xFF;
+    while (size--) {
+        crc ^= *data++;
+        for (uint8_t i = 0; i < 8; i++) {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+// The CRC covers every byte from the start of the frame up to and including
+// seq, any padding after the trailer is left out.
+void split_frame_seal(void *frame, split_frame_trailer_t *trailer, uint8_t seq) {
+    trailer->seq = seq;
+    trailer->crc = split_crc8(frame, (uint8_t *)trailer - (uint8_t *)frame + 1);
+}
+
+bool split_frame_valid(const void *frame, const split_frame_trailer_t *trailer) { return split_crc8(frame, (const uint8_t *)trailer - (const uint8_t *)frame + 1) == trailer->crc; }
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Trailer appended to every frame exchanged by the split transport.
+// seq is set by the sender and lets the receiver drop duplicates and
+// acknowledge frames; crc covers the payload and seq.
+typedef struct _split_frame_trailer_t {
+    uint8_t seq;
+    uint8_t crc;
+} split_frame_trailer_t;
+
+uint8_t split_crc8(const uint8_t *data, uint8_t size);
+
+// frame points to a struct whose last member is a split_frame_trailer_t and
+// trailer to that member. The struct may have tail padding after it.
+void split_frame_seal(void *frame, split_frame_trailer_t *trailer, uint8_t seq);
+bool split_frame_valid(const void *frame, const split_frame_trailer_t *trailer);
+
+// Checks that nothing but tail padding follows the trailer of type T
+#define SPLIT_FRAME_ASSERT(T) _Static_assert(sizeof(T) - offsetof(T, trailer) - sizeof(split_frame_trailer_t) < __alignof__(T), #T " must end with its trailer")
@@ -0,0 +1,123 @@
+#include <string.h>
+#include "split_stats.h"
+
+#ifdef CONSOLE_ENABLE
+#    include "print.h"
+#endif
+#ifdef RAW_ENABLE
+#    include "raw_hid.h"
+#endif
+
+static split_stats_t stats;
+static uint16_t      window_start;
+static uint32_t      window_bytes;
+static bool          window_started;
+
+void split_stats_reset(void) {
+    memset(&stats, 0, sizeof(stats));
+    window_bytes   = 0;
+    window_started = false;
+}
+
+const split_stats_t *split_stats_get(void) { return &stats; }
+
+static uint8_t rtt_bucket(uint16_t rtt) {
+    uint8_t bucket = 0;
+    while (rtt && bucket < SPLIT_STATS_RTT_BUCKETS - 1) {
+        rtt >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+void split_stats_record(bool success, uint8_t retries, uint16_t bytes, uint16_t start, uint16_t end) {
+    stats.transactions++;
+    stats.retries += retries;
+    if (!success) {
+        stats.failures++;
+    } else {
+        stats.bytes += bytes;
+        window_bytes += bytes;
+    }
+
+    uint16_t *bucket = &stats.rtt_histogram[rtt_bucket(end - start)];
+    if (*bucket < UINT16_MAX) {
+        (*bucket)++;
+    }
+
+    if (!window_started) {
+        window_start   = start;
+        window_started = true;
+    }
+    uint16_t elapsed = end - window_start;
+    if (elapsed >= SPLIT_STATS_WINDOW) {
+        uint32_t bps           = window_bytes * 1000 / elapsed;
+        stats.bytes_per_second = bps > UINT16_MAX ? UINT16_MAX : bps;
+        window_start           = end;
+        window_bytes           = 0;
+    }
+}
+
+static uint8_t *pack_u32(uint8_t *data, uint32_t value) {
+    *data++ = (value >> 24) & 0xFF;
+    *data++ = (value >> 16) & 0xFF;
+    *data++ = (value >> 8) & 0xFF;
+    *data++ = value & 0xFF;
+    return data;
+}
+
+static uint8_t *pack_u16(uint8_t *data, uint16_t value) {
+    *data++ = (value >> 8) & 0xFF;
+    *data++ = value & 0xFF;
+    return data;
+}
+
+uint8_t split_stats_pack(uint8_t *data, uint8_t offset, uint8_t length) {
+    uint8_t buffer[SPLIT_STATS_PACKED_SIZE];
+    uint8_t *p = buffer;
+
+    p = pack_u32(p, stats.transactions);
+    p = pack_u32(p, stats.failures);
+    p = pack_u32(p, stats.retries);
+    p = pack_u32(p, stats.bytes);
+    p = pack_u16(p, stats.bytes_per_second);
+    for (uint8_t i = 0; i < SPLIT_STATS_RTT_BUCKETS; i++) {
+        p = pack_u16(p, stats.rtt_histogram[i]);
+    }
+
+    if (offset >= sizeof(buffer)) {
+        return 0;
+    }
+    if (length > sizeof(buffer) - offset) {
+        length = sizeof(buffer) - offset;
+    }
+    memcpy(data, buffer + offset, length);
+    return length;
+}
+
+#ifdef RAW_ENABLE
+bool split_stats_raw_hid_receive(uint8_t *data, uint8_t length) {
+    if (length < 3 || data[0] != SPLIT_STATS_RAW_HID_ID) {
+        return false;
+    }
+    if (data[1] == split_stats_raw_hid_reset) {
+        split_stats_reset();
+    }
+    // data[2] is the offset into the serialized stats
+    split_stats_pack(&data[3], data[2], length - 3);
+    raw_hid_send(data, length);
+    return true;
+}
+#endif
+
+void split_stats_print(void) {
+#ifdef CONSOLE_ENABLE
+    uprintf("split: %lu transactions, %lu failures, %lu retries\n", stats.transactions, stats.failures, stats.retries);
+    uprintf("split: %lu bytes, %u bytes/s\n", stats.bytes, stats.bytes_per_second);
+    uprintf("split: rtt");
+    for (uint8_t i = 0; i < SPLIT_STATS_RTT_BUCKETS; i++) {
+        uprintf(" %u", stats.rtt_histogram[i]);
+    }
+    uprintf("\n");
+#endif
+}
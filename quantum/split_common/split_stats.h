@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Round trip times are bucketed by powers of two milliseconds:
+// bucket 0 is < 1ms, bucket n is [2^(n-1), 2^n) ms, the last bucket is open ended.
+#ifndef SPLIT_STATS_RTT_BUCKETS
+#    define SPLIT_STATS_RTT_BUCKETS 8
+#endif
+
+// Length of the window bytes_per_second is averaged over
+#ifndef SPLIT_STATS_WINDOW
+#    define SPLIT_STATS_WINDOW 1000
+#endif
+
+typedef struct {
+    uint32_t transactions;
+    uint32_t failures;
+    uint32_t retries;
+    uint32_t bytes;
+    uint16_t bytes_per_second;
+    uint16_t rtt_histogram[SPLIT_STATS_RTT_BUCKETS];
+} split_stats_t;
+
+// Size of the buffer written by split_stats_pack()
+#define SPLIT_STATS_PACKED_SIZE (4 * 4 + 2 + 2 * SPLIT_STATS_RTT_BUCKETS)
+
+void                 split_stats_reset(void);
+const split_stats_t *split_stats_get(void);
+
+// Called by the transport on the master for every transaction.
+// start and end are timer_read() values, retries is the number of repeated attempts
+// and bytes the payload moved in both directions.
+void split_stats_record(bool success, uint8_t retries, uint16_t bytes, uint16_t start, uint16_t end);
+
+// Writes up to length bytes of the big endian serialized stats, starting at offset,
+// into data for raw HID / VIA. Returns the number of bytes written.
+uint8_t split_stats_pack(uint8_t *data, uint8_t offset, uint8_t length);
+
+// First byte of the raw HID reports answered by split_stats_raw_hid_receive().
+// Must not collide with the command ids used by VIA or your own raw HID handler.
+#ifndef SPLIT_STATS_RAW_HID_ID
+#    define SPLIT_STATS_RAW_HID_ID 0x53
+#endif
+
+enum split_stats_raw_hid_command {
+    split_stats_raw_hid_get   = 0x00,
+    split_stats_raw_hid_reset = 0x01,
+};
+
+#ifdef RAW_ENABLE
+// Handles a report of { SPLIT_STATS_RAW_HID_ID, command, offset, ... }: resets the stats
+// for split_stats_raw_hid_reset, then replies with the serialized stats from the offset
+// written after the header. Returns false, leaving data untouched, for any other report.
+bool split_stats_raw_hid_receive(uint8_t *data, uint8_t length);
+#endif
+
+void split_stats_print(void);
@@ -0,0 +1,64 @@
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+extern "C" {
+#include "split_common/matrix_pack.h"
+}
+
+using testing::ElementsAreArray;
+
+TEST(MatrixPack, packs_rows_back_to_back) {
+    matrix_row_t matrix[2] = {0x1FFF, 0x0001};
+    uint8_t      packed[SPLIT_PACKED_MATRIX_SIZE(2, 13)];
+    split_matrix_pack(packed, matrix, 2, 13);
+    EXPECT_THAT(packed, ElementsAreArray({0xFF, 0x3F, 0x00, 0x00}));
+}
+
+TEST(MatrixPack, size_rounds_up_to_whole_bytes) {
+    EXPECT_EQ(SPLIT_PACKED_MATRIX_SIZE(5, 7), 5);
+    EXPECT_EQ(SPLIT_PACKED_MATRIX_SIZE(5, 8), 5);
+    EXPECT_EQ(SPLIT_PACKED_MATRIX_SIZE(5, 9), 6);
+    EXPECT_EQ(SPLIT_PACKED_MATRIX_SIZE(4, 14), 7);
+}
+
+TEST(MatrixPack, ignores_bits_above_column_count) {
+    matrix_row_t matrix[2] = {0xFFFF, 0x0000};
+    uint8_t      packed[SPLIT_PACKED_MATRIX_SIZE(2, 7)];
+    split_matrix_pack(packed, matrix, 2, 7);
+    EXPECT_THAT(packed, ElementsAreArray({0x7F, 0x00}));
+}
+
+TEST(MatrixPack, round_trips_every_single_key) {
+    for (uint8_t cols = 1; cols <= MATRIX_COLS; cols++) {
+        for (uint8_t row = 0; row < MATRIX_ROWS / 2; row++) {
+            for (uint8_t col = 0; col < cols; col++) {
+                matrix_row_t matrix[MATRIX_ROWS / 2] = {0};
+                matrix_row_t result[MATRIX_ROWS / 2];
+                uint8_t      packed[SPLIT_PACKED_MATRIX_SIZE(MATRIX_ROWS / 2, MATRIX_COLS)];
+                matrix[row] = MATRIX_ROW_SHIFTER << col;
+                split_matrix_pack(packed, matrix, MATRIX_ROWS / 2, cols);
+                split_matrix_unpack(result, packed, MATRIX_ROWS / 2, cols);
+                EXPECT_THAT(result, ElementsAreArray(matrix)) << "cols " << (int)cols << " row " << (int)row << " col " << (int)col;
+            }
+        }
+    }
+}
+
+TEST(MatrixPack, round_trips_full_matrix) {
+    matrix_row_t matrix[MATRIX_ROWS / 2] = {0x3FFF, 0x2AAA, 0x1555, 0x0000, 0x3001};
+    matrix_row_t result[MATRIX_ROWS / 2];
+    uint8_t      packed[SPLIT_PACKED_MATRIX_SIZE(MATRIX_ROWS / 2, MATRIX_COLS)];
+    split_matrix_pack(packed, matrix, MATRIX_ROWS / 2, MATRIX_COLS);
+    split_matrix_unpack(result, packed, MATRIX_ROWS / 2, MATRIX_COLS);
+    EXPECT_THAT(result, ElementsAreArray(matrix));
+}
+
+TEST(MatrixPack, pack_writes_only_the_packed_size) {
+    matrix_row_t matrix[3] = {0x7F, 0x00, 0x55};
+    uint8_t      packed[SPLIT_PACKED_MATRIX_SIZE(3, 7) + 1];
+    packed[sizeof(packed) - 1] = 0xFF;
+    split_matrix_pack(packed, matrix, 3, 7);
+    EXPECT_EQ(packed[sizeof(packed) - 1], 0xFF);
+    matrix_row_t result[3];
+    split_matrix_unpack(result, packed, 3, 7);
+    EXPECT_THAT(result, ElementsAreArray(matrix));
+}
@@ -0,0 +1,13 @@
+split_common_split_stats_DEFS := -DRAW_ENABLE
+split_common_split_stats_SRC :=\
+	$(QUANTUM_PATH)/split_common/tests/split_stats_tests.cpp \
+	$(QUANTUM_PATH)/split_common/split_stats.c
+
+split_common_matrix_pack_DEFS := -DMATRIX_ROWS=10 -DMATRIX_COLS=14
+split_common_matrix_pack_SRC :=\
+	$(QUANTUM_PATH)/split_common/tests/matrix_pack_tests.cpp \
+	$(QUANTUM_PATH)/split_common/matrix_pack.c
+
+split_common_split_frame_SRC :=\
+	$(QUANTUM_PATH)/split_common/tests/split_frame_tests.cpp \
+	$(QUANTUM_PATH)/split_common/split_frame.c
@@ -0,0 +1,58 @@
+#include "gtest/gtest.h"
+extern "C" {
+#include "split_common/split_frame.h"
+}
+
+typedef struct {
+    uint8_t               payload[6];
+    split_frame_trailer_t trailer;
+} test_frame_t;
+
+// Like Serial_rgblight_t on ARM, the trailer is followed by tail padding
+typedef struct {
+    uint32_t              payload[3];
+    split_frame_trailer_t trailer;
+} padded_frame_t;
+
+TEST(SplitFrame, sealed_frame_is_valid) {
+    test_frame_t frame = {{1, 2, 3, 4, 5, 6}};
+    split_frame_seal(&frame, &frame.trailer, 42);
+    EXPECT_EQ(frame.trailer.seq, 42);
+    EXPECT_TRUE(split_frame_valid(&frame, &frame.trailer));
+}
+
+TEST(SplitFrame, zeroed_frame_is_not_valid) {
+    test_frame_t frame = {};
+    EXPECT_FALSE(split_frame_valid(&frame, &frame.trailer));
+}
+
+TEST(SplitFrame, detects_every_single_bit_error) {
+    test_frame_t frame = {{0x55, 0xAA, 0x00, 0xFF, 0x12, 0x34}};
+    split_frame_seal(&frame, &frame.trailer, 7);
+    for (uint8_t byte = 0; byte < sizeof(frame); byte++) {
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            test_frame_t damaged = frame;
+            ((uint8_t*)&damaged)[byte] ^= 1 << bit;
+            EXPECT_FALSE(split_frame_valid(&damaged, &damaged.trailer)) << "byte " << (int)byte << " bit " << (int)bit;
+        }
+    }
+}
+
+TEST(SplitFrame, sequence_number_is_covered) {
+    test_frame_t frame = {{1, 2, 3, 4, 5, 6}};
+    split_frame_seal(&frame, &frame.trailer, 1);
+    frame.trailer.seq = 2;
+    EXPECT_FALSE(split_frame_valid(&frame, &frame.trailer));
+}
+
+TEST(SplitFrame, padded_frame_round_trips) {
+    padded_frame_t frame = {{0x01020304, 0x05060708, 0x090A0B0C}};
+    ASSERT_GT(sizeof(frame), offsetof(padded_frame_t, trailer) + sizeof(split_frame_trailer_t));
+    split_frame_seal(&frame, &frame.trailer, 9);
+    padded_frame_t received;
+    memcpy(&received, &frame, sizeof(received));
+    EXPECT_EQ(received.trailer.seq, 9);
+    EXPECT_TRUE(split_frame_valid(&received, &received.trailer));
+    received.payload[2] ^= 1;
+    EXPECT_FALSE(split_frame_valid(&received, &received.trailer));
+}
@@ -0,0 +1,135 @@
+#include "gtest/gtest.h"
+extern "C" {
+#include "split_common/split_stats.h"
+}
+
+static uint8_t raw_hid_sent[32];
+static uint8_t raw_hid_sent_length;
+
+extern "C" void raw_hid_send(uint8_t* data, uint8_t length) {
+    memcpy(raw_hid_sent, data, length);
+    raw_hid_sent_length = length;
+}
+
+// A simulated link that drops every nth transaction and takes a fixed time per attempt
+class LossyLink : public testing::Test {
+   public:
+    LossyLink() {
+        split_stats_reset();
+        raw_hid_sent_length = 0;
+    }
+
+    void run(uint16_t count, uint16_t drop_every, uint8_t max_retries, uint16_t bytes, uint16_t duration) {
+        for (uint16_t i = 0; i < count; i++) {
+            uint16_t start   = now;
+            uint8_t  retries = 0;
+            bool     success = false;
+            for (;;) {
+                attempts++;
+                now += duration;
+                success = !drop_every || (attempts % drop_every) != 0;
+                if (success || retries == max_retries) {
+                    break;
+                }
+                retries++;
+            }
+            split_stats_record(success, retries, bytes, start, now);
+        }
+    }
+
+    uint16_t now      = 0;
+    uint32_t attempts = 0;
+};
+
+TEST_F(LossyLink, counts_clean_transactions) {
+    run(100, 0, 0, 10, 1);
+    const split_stats_t* stats = split_stats_get();
+    EXPECT_EQ(stats->transactions, 100u);
+    EXPECT_EQ(stats->failures, 0u);
+    EXPECT_EQ(stats->retries, 0u);
+    EXPECT_EQ(stats->bytes, 1000u);
+}
+
+TEST_F(LossyLink, counts_failures_without_retries) {
+    run(100, 4, 0, 10, 1);
+    const split_stats_t* stats = split_stats_get();
+    EXPECT_EQ(stats->transactions, 100u);
+    EXPECT_EQ(stats->failures, 25u);
+    EXPECT_EQ(stats->bytes, 750u);
+}
+
+TEST_F(LossyLink, retries_recover_dropped_transactions) {
+    run(100, 4, 1, 10, 1);
+    const split_stats_t* stats = split_stats_get();
+    EXPECT_EQ(stats->failures, 0u);
+    EXPECT_EQ(stats->retries, 33u);
+    EXPECT_EQ(stats->bytes, 1000u);
+}
+
+TEST_F(LossyLink, buckets_round_trip_times_by_power_of_two) {
+    split_stats_record(true, 0, 1, 0, 0);
+    split_stats_record(true, 0, 1, 0, 1);
+    split_stats_record(true, 0, 1, 0, 3);
+    split_stats_record(true, 0, 1, 0, 100);
+    split_stats_record(false, 0, 0, 0, 60000);
+    const split_stats_t* stats = split_stats_get();
+    EXPECT_EQ(stats->rtt_histogram[0], 1u);
+    EXPECT_EQ(stats->rtt_histogram[1], 1u);
+    EXPECT_EQ(stats->rtt_histogram[2], 1u);
+    EXPECT_EQ(stats->rtt_histogram[SPLIT_STATS_RTT_BUCKETS - 1], 2u);
+}
+
+TEST_F(LossyLink, measures_throughput_over_the_window) {
+    run(SPLIT_STATS_WINDOW / 2, 0, 0, 10, 2);
+    EXPECT_EQ(split_stats_get()->bytes_per_second, 5000u);
+}
+
+TEST_F(LossyLink, throughput_excludes_failed_transactions) {
+    run(SPLIT_STATS_WINDOW / 2, 2, 0, 10, 2);
+    EXPECT_EQ(split_stats_get()->bytes_per_second, 2500u);
+}
+
+TEST_F(LossyLink, handles_timer_wraparound) {
+    now = 0xFFFF - 10;
+    run(SPLIT_STATS_WINDOW, 0, 0, 4, 1);
+    EXPECT_EQ(split_stats_get()->bytes_per_second, 4000u);
+    EXPECT_EQ(split_stats_get()->rtt_histogram[1], SPLIT_STATS_WINDOW);
+}
+
+TEST_F(LossyLink, packs_big_endian_with_offset) {
+    run(0x102, 0, 0, 1, 1);
+    uint8_t data[SPLIT_STATS_PACKED_SIZE + 4] = {0};
+    EXPECT_EQ(split_stats_pack(data, 0, sizeof(data)), SPLIT_STATS_PACKED_SIZE);
+    EXPECT_EQ(data[2], 0x01);
+    EXPECT_EQ(data[3], 0x02);
+    EXPECT_EQ(split_stats_pack(data, 2, 2), 2);
+    EXPECT_EQ(data[0], 0x01);
+    EXPECT_EQ(data[1], 0x02);
+    EXPECT_EQ(split_stats_pack(data, SPLIT_STATS_PACKED_SIZE, 4), 0);
+}
+
+TEST_F(LossyLink, answers_raw_hid_reports) {
+    run(0x102, 0, 0, 1, 1);
+    uint8_t data[32] = {SPLIT_STATS_RAW_HID_ID, split_stats_raw_hid_get, 2};
+    EXPECT_TRUE(split_stats_raw_hid_receive(data, sizeof(data)));
+    EXPECT_EQ(raw_hid_sent_length, sizeof(data));
+    EXPECT_EQ(raw_hid_sent[0], SPLIT_STATS_RAW_HID_ID);
+    EXPECT_EQ(raw_hid_sent[3], 0x01);
+    EXPECT_EQ(raw_hid_sent[4], 0x02);
+}
+
+TEST_F(LossyLink, resets_over_raw_hid) {
+    run(10, 0, 0, 1, 1);
+    uint8_t data[32] = {SPLIT_STATS_RAW_HID_ID, split_stats_raw_hid_reset, 0};
+    EXPECT_TRUE(split_stats_raw_hid_receive(data, sizeof(data)));
+    EXPECT_EQ(split_stats_get()->transactions, 0u);
+    EXPECT_EQ(raw_hid_sent[6], 0x00);
+}
+
+TEST_F(LossyLink, ignores_other_raw_hid_reports) {
+    uint8_t data[32] = {SPLIT_STATS_RAW_HID_ID + 1, split_stats_raw_hid_reset, 0};
+    run(10, 0, 0, 1, 1);
+    EXPECT_FALSE(split_stats_raw_hid_receive(data, sizeof(data)));
+    EXPECT_EQ(raw_hid_sent_length, 0);
+    EXPECT_EQ(split_stats_get()->transactions, 10u);
+}
@@ -0,0 +1,4 @@
+TEST_LIST +=\
+	split_common_split_stats\
+	split_common_matrix_pack\
+	split_common_split_frame
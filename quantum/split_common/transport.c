@@ -7,6 +7,10 @@
 
 #define ROWS_PER_HAND (MATRIX_ROWS / 2)
 
+#ifndef MIN
+#    define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+
 #ifdef RGBLIGHT_ENABLE
 #    include "rgblight.h"
 #endif
@@ -15,6 +19,23 @@
 #    include "backlight.h"
 #endif
 
+#ifdef SPLIT_LINK_STATS_ENABLE
+#    include "split_stats.h"
+#endif
+
+// Rows are padded to 8, 16 or 32 bits, so only send one bit per key when
+// the column count leaves unused bits in each row.
+#if (MATRIX_COLS % 8) != 0
+#    include "matrix_pack.h"
+#    define SPLIT_MATRIX_SIZE SPLIT_PACKED_MATRIX_SIZE(ROWS_PER_HAND, MATRIX_COLS)
+#    define transport_pack_matrix(packed, matrix) split_matrix_pack((packed), (matrix), ROWS_PER_HAND, MATRIX_COLS)
+#    define transport_unpack_matrix(matrix, packed) split_matrix_unpack((matrix), (packed), ROWS_PER_HAND, MATRIX_COLS)
+#else
+#    define SPLIT_MATRIX_SIZE (ROWS_PER_HAND * sizeof(matrix_row_t))
+#    define transport_pack_matrix(packed, matrix) memcpy((packed), (matrix), SPLIT_MATRIX_SIZE)
+#    define transport_unpack_matrix(matrix, packed) memcpy((matrix), (packed), SPLIT_MATRIX_SIZE)
+#endif
+
 #ifdef ENCODER_ENABLE
 #    include "encoder.h"
 static pin_t encoders_pad[] = ENCODERS_PAD_A;
@@ -26,20 +47,26 @@ static pin_t encoders_pad[] = ENCODERS_PAD_A;
 #    include "i2c_master.h"
 #    include "i2c_slave.h"
 
+// The master to slave fields come first and the slave to master fields
+// directly after them, so that a single combined transaction can write any
+// changed master fields and then, after a repeated start, keep reading the
+// slave fields from where the register pointer was left.
 typedef struct _I2C_slave_buffer_t {
-    matrix_row_t smatrix[ROWS_PER_HAND];
-    uint8_t      backlight_level;
 #    if defined(RGBLIGHT_ENABLE) && defined(RGBLIGHT_SPLIT)
     rgblight_syncinfo_t rgblight_sync;
 #    endif
-#    ifdef ENCODER_ENABLE
-    uint8_t encoder_state[NUMBER_OF_ENCODERS];
-#    endif
+    uint8_t backlight_level;
 #    ifdef WPM_ENABLE
     uint8_t current_wpm;
+#    endif
+    uint8_t smatrix[SPLIT_MATRIX_SIZE];
+#    ifdef ENCODER_ENABLE
+    uint8_t encoder_state[NUMBER_OF_ENCODERS];
 #    endif
 } I2C_slave_buffer_t;
 
+_Static_assert(sizeof(I2C_slave_buffer_t) <= I2C_SLAVE_REG_COUNT, "I2C_slave_buffer_t does not fit in the I2C slave registers");
+
 static I2C_slave_buffer_t *const i2c_buffer = (I2C_slave_buffer_t *)i2c_slave_reg;
 
 #    define I2C_BACKLIGHT_START offsetof(I2C_slave_buffer_t, backlight_level)
@@ -47,56 +74,135 @@ static I2C_slave_buffer_t *const i2c_buffer = (I2C_slave_buffer_t *)i2c_slave_re
 #    define I2C_KEYMAP_START offsetof(I2C_slave_buffer_t, smatrix)
 #    define I2C_ENCODER_START offsetof(I2C_slave_buffer_t, encoder_state)
 #    define I2C_WPM_START offsetof(I2C_slave_buffer_t, current_wpm)
+#    define I2C_S2M_START I2C_KEYMAP_START
+#    define I2C_S2M_SIZE (sizeof(I2C_slave_buffer_t) - I2C_S2M_START)
 
-#    define TIMEOUT 100
+#    ifndef SPLIT_I2C_TIMEOUT
+#        define SPLIT_I2C_TIMEOUT 100
+#    endif
+
+// Number of immediate retries after a NACK before backing off
+#    ifndef SPLIT_I2C_RETRIES
+#        define SPLIT_I2C_RETRIES 2
+#    endif
+
+// Upper bound, in milliseconds, of the exponential backoff after failed scans
+#    ifndef SPLIT_I2C_BACKOFF_MAX
+#        define SPLIT_I2C_BACKOFF_MAX 512
+#    endif
 
 #    ifndef SLAVE_I2C_ADDRESS
 #        define SLAVE_I2C_ADDRESS 0x32
 #    endif
 
-// Get rows from other half over i2c
-bool transport_master(matrix_row_t matrix[]) {
-    i2c_readReg(SLAVE_I2C_ADDRESS, I2C_KEYMAP_START, (void *)matrix, sizeof(i2c_buffer->smatrix), TIMEOUT);
-
-    // write backlight info
-#    ifdef BACKLIGHT_ENABLE
-    uint8_t level = is_backlight_enabled() ? get_backlight_level() : 0;
-    if (level != i2c_buffer->backlight_level) {
-        if (i2c_writeReg(SLAVE_I2C_ADDRESS, I2C_BACKLIGHT_START, (void *)&level, sizeof(level), TIMEOUT) >= 0) {
-            i2c_buffer->backlight_level = level;
+static struct {
+    uint8_t  consecutive_errors;
+    uint16_t backoff;
+    uint16_t last_attempt;
+} i2c_link;
+
+// Master side shadow of what the slave last acknowledged
+static I2C_slave_buffer_t i2c_sent;
+
+static void i2c_link_update(bool success) {
+    if (success) {
+        i2c_link.consecutive_errors = 0;
+        i2c_link.backoff            = 0;
+    } else {
+        if (i2c_link.consecutive_errors < UINT8_MAX) {
+            i2c_link.consecutive_errors++;
         }
+        // 1, 2, 4, ... ms, so a slave still booting is not hammered with full timeouts every scan
+        i2c_link.backoff = i2c_link.backoff ? MIN(i2c_link.backoff * 2, SPLIT_I2C_BACKOFF_MAX) : 1;
     }
-#    endif
+    i2c_link.last_attempt = timer_read();
+}
 
+// Write all master fields from the first one that differs from the shadow
+// copy, then read back every slave field in the same transaction.
+static bool i2c_combined_transaction(I2C_slave_buffer_t *tx, matrix_row_t matrix[]) {
+    uint8_t start = I2C_S2M_START;
 #    if defined(RGBLIGHT_ENABLE) && defined(RGBLIGHT_SPLIT)
-    if (rgblight_get_change_flags()) {
-        rgblight_syncinfo_t rgblight_sync;
-        rgblight_get_syncinfo(&rgblight_sync);
-        if (i2c_writeReg(SLAVE_I2C_ADDRESS, I2C_RGB_START, (void *)&rgblight_sync, sizeof(rgblight_sync), TIMEOUT) >= 0) {
-            rgblight_clear_change_flags();
-        }
+    if (tx->rgblight_sync.status.change_flags) {
+        start = I2C_RGB_START;
     }
 #    endif
+#    ifdef WPM_ENABLE
+    if (start == I2C_S2M_START && tx->current_wpm != i2c_sent.current_wpm) {
+        start = I2C_WPM_START;
+    }
+#    endif
+    if (start >= I2C_BACKLIGHT_START && tx->backlight_level != i2c_sent.backlight_level) {
+        start = I2C_BACKLIGHT_START;
+    }
 
+    uint8_t rx[I2C_S2M_SIZE];
+#    ifdef SPLIT_LINK_STATS_ENABLE
+    uint16_t started = timer_read();
+#    endif
+    // A NACK is retried right away, a timeout is not as it already stalled the scan
+    i2c_status_t status;
+    uint8_t      attempt = 0;
+    while ((status = i2c_writeReadReg(SLAVE_I2C_ADDRESS, start, (uint8_t *)tx + start, I2C_S2M_START - start, rx, sizeof(rx), SPLIT_I2C_TIMEOUT)) == I2C_STATUS_ERROR && attempt < SPLIT_I2C_RETRIES) {
+        attempt++;
+    }
+    if (status != I2C_STATUS_SUCCESS) {
+#    ifdef SPLIT_LINK_STATS_ENABLE
+        split_stats_record(false, attempt, 0, started, timer_read());
+#    endif
+        return false;
+    }
+#    ifdef SPLIT_LINK_STATS_ENABLE
+    split_stats_record(true, attempt, 1 + (I2C_S2M_START - start) + sizeof(rx), started, timer_read());
+#    endif
+    memcpy((uint8_t *)&i2c_sent, tx, I2C_S2M_START);
+    transport_unpack_matrix(matrix, rx);
 #    ifdef ENCODER_ENABLE
-    i2c_readReg(SLAVE_I2C_ADDRESS, I2C_ENCODER_START, (void *)i2c_buffer->encoder_state, sizeof(i2c_buffer->encoder_state), TIMEOUT);
-    encoder_update_raw(i2c_buffer->encoder_state);
+    memcpy(i2c_sent.encoder_state, rx + (I2C_ENCODER_START - I2C_S2M_START), sizeof(i2c_sent.encoder_state));
 #    endif
+    return true;
+}
 
+// Get rows from other half over i2c
+bool transport_master(matrix_row_t matrix[]) {
+    if (i2c_link.backoff && timer_elapsed(i2c_link.last_attempt) < i2c_link.backoff) {
+        return false;
+    }
+
+    I2C_slave_buffer_t tx;
+#    if defined(RGBLIGHT_ENABLE) && defined(RGBLIGHT_SPLIT)
+    rgblight_get_syncinfo(&tx.rgblight_sync);
+#    endif
+#    ifdef BACKLIGHT_ENABLE
+    tx.backlight_level = is_backlight_enabled() ? get_backlight_level() : 0;
+#    else
+    tx.backlight_level = i2c_sent.backlight_level;
+#    endif
 #    ifdef WPM_ENABLE
-    uint8_t current_wpm = get_current_wpm();
-    if (current_wpm != i2c_buffer->current_wpm) {
-        if (i2c_writeReg(SLAVE_I2C_ADDRESS, I2C_WPM_START, (void *)&current_wpm, sizeof(current_wpm), TIMEOUT) >= 0) {
-            i2c_buffer->current_wpm = current_wpm;
-        }
+    tx.current_wpm = get_current_wpm();
+#    endif
+
+    bool success = i2c_combined_transaction(&tx, matrix);
+    i2c_link_update(success);
+    if (!success) {
+        return false;
     }
+
+#    if defined(RGBLIGHT_ENABLE) && defined(RGBLIGHT_SPLIT)
+    if (tx.rgblight_sync.status.change_flags) {
+        rgblight_clear_change_flags();
+    }
+#    endif
+
+#    ifdef ENCODER_ENABLE
+    encoder_update_raw(i2c_sent.encoder_state);
 #    endif
     return true;
 }
 
 void transport_slave(matrix_row_t matrix[]) {
     // Copy matrix to I2C buffer
-    memcpy((void *)i2c_buffer->smatrix, (void *)matrix, sizeof(i2c_buffer->smatrix));
+    transport_pack_matrix((uint8_t *)i2c_buffer->smatrix, matrix);
 
 // Read Backlight Info
 #    ifdef BACKLIGHT_ENABLE
@@ -128,14 +234,22 @@ void transport_slave_init(void) { i2c_slave_init(SLAVE_I2C_ADDRESS); }
 
 #    include "serial.h"
 
+#    ifdef SPLIT_SERIAL_CRC
+#        include "split_frame.h"
+#    endif
+
 typedef struct _Serial_s2m_buffer_t {
-    // TODO: if MATRIX_COLS > 8 change to uint8_t packed_matrix[] for pack/unpack
-    matrix_row_t smatrix[ROWS_PER_HAND];
+    uint8_t smatrix[SPLIT_MATRIX_SIZE];
 
 #    ifdef ENCODER_ENABLE
     uint8_t      encoder_state[NUMBER_OF_ENCODERS];
 #    endif
 
+#    ifdef SPLIT_SERIAL_CRC
+    // last rgblight frame the slave applied
+    uint8_t               rgblight_ack;
+    split_frame_trailer_t trailer;
+#    endif
 } Serial_s2m_buffer_t;
 
 typedef struct _Serial_m2s_buffer_t {
@@ -145,6 +259,9 @@ typedef struct _Serial_m2s_buffer_t {
 #    ifdef WPM_ENABLE
     uint8_t current_wpm;
 #    endif
+#    ifdef SPLIT_SERIAL_CRC
+    split_frame_trailer_t trailer;
+#    endif
 } Serial_m2s_buffer_t;
 
 #    if defined(RGBLIGHT_ENABLE) && defined(RGBLIGHT_SPLIT)
@@ -158,6 +275,9 @@ typedef struct _Serial_m2s_buffer_t {
 
 typedef struct _Serial_rgblight_t {
     rgblight_syncinfo_t rgblight_sync;
+#        ifdef SPLIT_SERIAL_CRC
+    split_frame_trailer_t trailer;
+#        endif
 } Serial_rgblight_t;
 
 volatile Serial_rgblight_t serial_rgblight = {};
@@ -168,6 +288,27 @@ volatile Serial_s2m_buffer_t serial_s2m_buffer = {};
 volatile Serial_m2s_buffer_t serial_m2s_buffer = {};
 uint8_t volatile status0                       = 0;
 
+#    ifdef SPLIT_SERIAL_CRC
+// The serial ISR reads and writes the buffers at any time, so the main loop
+// only ever acts on a copy whose CRC matches, and torn frames are dropped.
+static uint8_t serial_seq;
+
+#        define serial_seal(buffer, seq) split_frame_seal((void *)&(buffer), (split_frame_trailer_t *)&(buffer).trailer, (seq))
+#        define serial_copy_valid(dest, src) (memcpy(&(dest), (void *)&(src), sizeof(dest)), split_frame_valid(&(dest), &(dest).trailer))
+
+SPLIT_FRAME_ASSERT(Serial_s2m_buffer_t);
+SPLIT_FRAME_ASSERT(Serial_m2s_buffer_t);
+#        if defined(RGBLIGHT_ENABLE) && defined(RGBLIGHT_SPLIT)
+SPLIT_FRAME_ASSERT(Serial_rgblight_t);
+#        endif
+
+// last master frame that passed the CRC check
+static Serial_m2s_buffer_t serial_m2s_valid;
+#        define serial_m2s serial_m2s_valid
+#    else
+#        define serial_m2s serial_m2s_buffer
+#    endif
+
 enum serial_transaction_id {
     GET_SLAVE_MATRIX = 0,
 #    if defined(RGBLIGHT_ENABLE) && defined(RGBLIGHT_SPLIT)
@@ -192,7 +333,12 @@ SSTD_t transactions[] = {
 #    endif
 };
 
-void transport_master_init(void) { soft_serial_initiator_init(transactions, TID_LIMIT(transactions)); }
+void transport_master_init(void) {
+#    ifdef SPLIT_SERIAL_CRC
+    serial_seal(serial_m2s_buffer, ++serial_seq);
+#    endif
+    soft_serial_initiator_init(transactions, TID_LIMIT(transactions));
+}
 
 void transport_slave_init(void) { soft_serial_target_init(transactions, TID_LIMIT(transactions)); }
 
@@ -200,19 +346,70 @@ void transport_slave_init(void) { soft_serial_target_init(transactions, TID_LIMI
 
 // rgblight synchronization information communication.
 
+#        ifdef SPLIT_SERIAL_CRC
+// Resend an unacknowledged rgblight frame after this many milliseconds
+#            ifndef SPLIT_SERIAL_RESEND_INTERVAL
+#                define SPLIT_SERIAL_RESEND_INTERVAL 20
+#            endif
+
+// seq of the rgblight frame waiting for the slave's acknowledgement, 0 if none
+static uint8_t  rgblight_unacked;
+static uint16_t rgblight_sent;
+
+void transport_rgblight_master(void) {
+    if (rgblight_get_change_flags()) {
+        rgblight_syncinfo_t rgblight_sync;
+        rgblight_get_syncinfo(&rgblight_sync);
+        if (!rgblight_unacked || memcmp(&rgblight_sync, (void *)&serial_rgblight.rgblight_sync, sizeof(rgblight_sync)) != 0) {
+            serial_rgblight.rgblight_sync = rgblight_sync;
+            rgblight_unacked              = ++serial_seq ? serial_seq : ++serial_seq;
+            serial_seal(serial_rgblight, rgblight_unacked);
+        } else if (timer_elapsed(rgblight_sent) < SPLIT_SERIAL_RESEND_INTERVAL) {
+            // the change flags are cleared once the slave acknowledged the frame
+            return;
+        }
+        rgblight_sent = timer_read();
+#            ifdef SPLIT_LINK_STATS_ENABLE
+        int status = soft_serial_transaction(PUT_RGBLIGHT);
+        split_stats_record(status == TRANSACTION_END, 0, sizeof(serial_rgblight), rgblight_sent, timer_read());
+#            else
+        soft_serial_transaction(PUT_RGBLIGHT);
+#            endif
+    }
+}
+#        else
 void transport_rgblight_master(void) {
     if (rgblight_get_change_flags()) {
         rgblight_get_syncinfo((rgblight_syncinfo_t *)&serial_rgblight.rgblight_sync);
-        if (soft_serial_transaction(PUT_RGBLIGHT) == TRANSACTION_END) {
+#            ifdef SPLIT_LINK_STATS_ENABLE
+        uint16_t started = timer_read();
+#            endif
+        int status = soft_serial_transaction(PUT_RGBLIGHT);
+#            ifdef SPLIT_LINK_STATS_ENABLE
+        split_stats_record(status == TRANSACTION_END, 0, sizeof(serial_rgblight), started, timer_read());
+#            endif
+        if (status == TRANSACTION_END) {
             rgblight_clear_change_flags();
         }
     }
 }
+#        endif
 
 void transport_rgblight_slave(void) {
     if (status_rgblight == TRANSACTION_ACCEPTED) {
+#        ifdef SPLIT_SERIAL_CRC
+        Serial_rgblight_t received;
+        status_rgblight = TRANSACTION_END;
+        // the master repeats the frame until acknowledged, apply it only once
+        if (!serial_copy_valid(received, serial_rgblight) || received.trailer.seq == serial_s2m_buffer.rgblight_ack) {
+            return;
+        }
+        rgblight_update_sync(&received.rgblight_sync, false);
+        serial_s2m_buffer.rgblight_ack = received.trailer.seq;
+#        else
         rgblight_update_sync((rgblight_syncinfo_t *)&serial_rgblight.rgblight_sync, false);
         status_rgblight = TRANSACTION_END;
+#        endif
     }
 }
 
@@ -222,21 +419,36 @@ void transport_rgblight_slave(void) {
 #    endif
 
 bool transport_master(matrix_row_t matrix[]) {
+#    ifdef SPLIT_LINK_STATS_ENABLE
+    uint16_t started = timer_read();
+#    endif
 #    ifndef SERIAL_USE_MULTI_TRANSACTION
-    if (soft_serial_transaction() != TRANSACTION_END) {
-        return false;
-    }
+    int status = soft_serial_transaction();
 #    else
     transport_rgblight_master();
-    if (soft_serial_transaction(GET_SLAVE_MATRIX) != TRANSACTION_END) {
-        return false;
+    int status = soft_serial_transaction(GET_SLAVE_MATRIX);
+#    endif
+#    ifdef SPLIT_SERIAL_CRC
+    // soft serial only checks parity, reject frames corrupted by noise
+    if (status == TRANSACTION_END && !split_frame_valid((void *)&serial_s2m_buffer, (split_frame_trailer_t *)&serial_s2m_buffer.trailer)) {
+        status = TRANSACTION_DATA_ERROR;
     }
 #    endif
+#    ifdef SPLIT_LINK_STATS_ENABLE
+    split_stats_record(status == TRANSACTION_END, 0, sizeof(serial_m2s_buffer) + sizeof(serial_s2m_buffer), started, timer_read());
+#    endif
+    if (status != TRANSACTION_END) {
+        return false;
+    }
+
+    transport_unpack_matrix(matrix, (uint8_t *)serial_s2m_buffer.smatrix);
 
-    // TODO:  if MATRIX_COLS > 8 change to unpack()
-    for (int i = 0; i < ROWS_PER_HAND; ++i) {
-        matrix[i] = serial_s2m_buffer.smatrix[i];
+#    if defined(SPLIT_SERIAL_CRC) && defined(RGBLIGHT_ENABLE) && defined(RGBLIGHT_SPLIT)
+    if (rgblight_unacked && serial_s2m_buffer.rgblight_ack == rgblight_unacked) {
+        rgblight_clear_change_flags();
+        rgblight_unacked = 0;
     }
+#    endif
 
 #    ifdef BACKLIGHT_ENABLE
     // Write backlight level for slave to read
@@ -251,25 +463,37 @@ bool transport_master(matrix_row_t matrix[]) {
     // Write wpm to slave
     serial_m2s_buffer.current_wpm = get_current_wpm();
 #    endif
+
+#    ifdef SPLIT_SERIAL_CRC
+    serial_seal(serial_m2s_buffer, ++serial_seq);
+#    endif
     return true;
 }
 
 void transport_slave(matrix_row_t matrix[]) {
     transport_rgblight_slave();
-    // TODO: if MATRIX_COLS > 8 change to pack()
-    for (int i = 0; i < ROWS_PER_HAND; ++i) {
-        serial_s2m_buffer.smatrix[i] = matrix[i];
-    }
-#    ifdef BACKLIGHT_ENABLE
-    backlight_set(serial_m2s_buffer.backlight_level);
-#    endif
+    transport_pack_matrix((uint8_t *)serial_s2m_buffer.smatrix, matrix);
 
 #    ifdef ENCODER_ENABLE
     encoder_state_raw((uint8_t *)serial_s2m_buffer.encoder_state);
 #    endif
 
+#    ifdef SPLIT_SERIAL_CRC
+    serial_seal(serial_s2m_buffer, serial_s2m_buffer.trailer.seq + 1);
+
+    // keep the last good values when the frame from the master is damaged
+    Serial_m2s_buffer_t received;
+    if (serial_copy_valid(received, serial_m2s_buffer)) {
+        serial_m2s_valid = received;
+    }
+#    endif
+
+#    ifdef BACKLIGHT_ENABLE
+    backlight_set(serial_m2s.backlight_level);
+#    endif
+
 #    ifdef WPM_ENABLE
-    set_current_wpm(serial_m2s_buffer.current_wpm);
+    set_current_wpm(serial_m2s.current_wpm);
 #    endif
 }
 
@@ -8,3 +8,11 @@ void transport_slave_init(void);
 // returns false if valid data not received from slave
 bool transport_master(matrix_row_t matrix[]);
 void transport_slave(matrix_row_t matrix[]);
+
+#ifdef SPLIT_TRANSPORT_NODES
+// In node mode matrix is the full matrix on the master, and every polled
+// peripheral's rows are written in place.
+uint8_t split_node_index(void);
+uint8_t split_node_row_offset(uint8_t node);
+uint8_t split_node_row_count(uint8_t node);
+#endif
@@ -0,0 +1,318 @@
+#include <string.h>
+#include <stddef.h>
+
+#include "config.h"
+#include "matrix.h"
+#include "quantum.h"
+#include "split_util.h"
+#include "transport.h"
+
+#include "i2c_master.h"
+#include "i2c_slave.h"
+
+#ifndef MIN
+#    define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+
+#ifdef RGBLIGHT_ENABLE
+#    include "rgblight.h"
+#endif
+
+#ifdef BACKLIGHT_ENABLE
+#    include "backlight.h"
+#endif
+
+#ifdef SPLIT_LINK_STATS_ENABLE
+#    include "split_stats.h"
+#endif
+
+#ifdef ENCODER_ENABLE
+#    error "SPLIT_TRANSPORT = nodes does not support ENCODER_ENABLE"
+#endif
+
+#if !defined(SPLIT_NODE_ROWS) || !defined(SPLIT_NODE_ADDRESSES)
+#    error "SPLIT_TRANSPORT = nodes requires SPLIT_NODE_ROWS and SPLIT_NODE_ADDRESSES"
+#endif
+
+static const uint8_t node_rows[]      = SPLIT_NODE_ROWS;
+static const uint8_t node_addresses[] = SPLIT_NODE_ADDRESSES;
+#define NUMBER_OF_NODES (sizeof(node_rows) / sizeof(node_rows[0]))
+
+_Static_assert(sizeof(node_addresses) == sizeof(node_rows), "SPLIT_NODE_ADDRESSES needs one entry per node");
+
+// Poll node n only every node_intervals[n] rounds, so slow or rarely used
+// peripherals do not cost bus time every scan
+#ifdef SPLIT_NODE_POLL_INTERVALS
+static const uint8_t node_intervals[] = SPLIT_NODE_POLL_INTERVALS;
+_Static_assert(sizeof(node_intervals) == sizeof(node_rows), "SPLIT_NODE_POLL_INTERVALS needs one entry per node");
+#endif
+
+// Maximum number of peripherals polled by a single matrix scan
+#ifndef SPLIT_NODE_POLLS_PER_SCAN
+#    define SPLIT_NODE_POLLS_PER_SCAN NUMBER_OF_NODES
+#endif
+
+// Largest row count of any node, sizes the slave register block
+#ifndef SPLIT_NODE_MAX_ROWS
+#    define SPLIT_NODE_MAX_ROWS (MATRIX_ROWS / 2)
+#endif
+
+#ifndef SPLIT_I2C_TIMEOUT
+#    define SPLIT_I2C_TIMEOUT 100
+#endif
+
+#ifndef SPLIT_I2C_RETRIES
+#    define SPLIT_I2C_RETRIES 2
+#endif
+
+#ifndef SPLIT_I2C_BACKOFF_MAX
+#    define SPLIT_I2C_BACKOFF_MAX 512
+#endif
+
+#define ERROR_DISCONNECT_COUNT 5
+
+#if (MATRIX_COLS % 8) != 0
+#    include "matrix_pack.h"
+#    define SPLIT_MATRIX_SIZE SPLIT_PACKED_MATRIX_SIZE(SPLIT_NODE_MAX_ROWS, MATRIX_COLS)
+#    define node_matrix_size(rows) SPLIT_PACKED_MATRIX_SIZE(rows, MATRIX_COLS)
+#    define transport_pack_matrix(packed, matrix, rows) split_matrix_pack((packed), (matrix), (rows), MATRIX_COLS)
+#    define transport_unpack_matrix(matrix, packed, rows) split_matrix_unpack((matrix), (packed), (rows), MATRIX_COLS)
+#else
+#    define SPLIT_MATRIX_SIZE (SPLIT_NODE_MAX_ROWS * sizeof(matrix_row_t))
+#    define node_matrix_size(rows) ((rows) * sizeof(matrix_row_t))
+#    define transport_pack_matrix(packed, matrix, rows) memcpy((packed), (matrix), node_matrix_size(rows))
+#    define transport_unpack_matrix(matrix, packed, rows) memcpy((matrix), (packed), node_matrix_size(rows))
+#endif
+
+// Same layout as the two half I2C transport: master to node fields first,
+// then the node matrix, so that one combined transaction serves each poll.
+typedef struct _I2C_node_buffer_t {
+#if defined(RGBLIGHT_ENABLE) && defined(RGBLIGHT_SPLIT)
+    rgblight_syncinfo_t rgblight_sync;
+#endif
+    uint8_t backlight_level;
+#ifdef WPM_ENABLE
+    uint8_t current_wpm;
+#endif
+    uint8_t smatrix[SPLIT_MATRIX_SIZE];
+} I2C_node_buffer_t;
+
+_Static_assert(sizeof(I2C_node_buffer_t) <= I2C_SLAVE_REG_COUNT, "I2C_node_buffer_t does not fit in the I2C slave registers");
+
+static I2C_node_buffer_t *const i2c_buffer = (I2C_node_buffer_t *)i2c_slave_reg;
+
+#define I2C_BACKLIGHT_START offsetof(I2C_node_buffer_t, backlight_level)
+#define I2C_RGB_START offsetof(I2C_node_buffer_t, rgblight_sync)
+#define I2C_WPM_START offsetof(I2C_node_buffer_t, current_wpm)
+#define I2C_KEYMAP_START offsetof(I2C_node_buffer_t, smatrix)
+
+typedef struct {
+    uint8_t  row_offset;
+    uint8_t  row_count;
+    uint8_t  rounds_since_poll;
+    uint8_t  consecutive_errors;
+    uint16_t backoff;
+    uint16_t last_attempt;
+    uint8_t  backlight_level;
+#ifdef WPM_ENABLE
+    uint8_t current_wpm;
+#endif
+} split_node_t;
+
+static split_node_t nodes[NUMBER_OF_NODES];
+static uint8_t      next_node;
+
+#if defined(RGBLIGHT_ENABLE) && defined(RGBLIGHT_SPLIT)
+// rgblight change flags are global, so keep the update until every node took it
+static rgblight_syncinfo_t rgblight_sync;
+static uint8_t             rgblight_pending;
+
+_Static_assert(NUMBER_OF_NODES <= 8, "rgblight_pending holds one bit per node");
+#endif
+
+__attribute__((weak)) uint8_t split_node_index(void) {
+#ifdef SPLIT_NODE_INDEX
+    return SPLIT_NODE_INDEX;
+#else
+    return isLeftHand ? 0 : 1;
+#endif
+}
+
+uint8_t split_node_row_offset(uint8_t node) {
+    uint8_t offset = 0;
+    for (uint8_t i = 0; i < node; i++) {
+        offset += node_rows[i];
+    }
+    return MIN(offset, MATRIX_ROWS);
+}
+
+// The row counts cannot be checked at compile time, so a node is clamped to
+// SPLIT_NODE_MAX_ROWS and to the end of the matrix rather than overflowing
+// the register block or the master matrix
+uint8_t split_node_row_count(uint8_t node) {
+    uint8_t rows = MIN(node_rows[node], SPLIT_NODE_MAX_ROWS);
+    return MIN(rows, MATRIX_ROWS - split_node_row_offset(node));
+}
+
+static void nodes_init(void) {
+    for (uint8_t i = 0; i < NUMBER_OF_NODES; i++) {
+        nodes[i].row_offset = split_node_row_offset(i);
+        nodes[i].row_count  = split_node_row_count(i);
+    }
+}
+
+static bool node_due(uint8_t node) {
+    split_node_t *n = &nodes[node];
+#ifdef SPLIT_NODE_POLL_INTERVALS
+    if (n->rounds_since_poll < node_intervals[node]) {
+        return false;
+    }
+#endif
+    return !n->backoff || timer_elapsed(n->last_attempt) >= n->backoff;
+}
+
+static void node_update_health(uint8_t node, bool success, matrix_row_t matrix[]) {
+    split_node_t *n = &nodes[node];
+    if (success) {
+        n->consecutive_errors = 0;
+        n->backoff            = 0;
+    } else {
+        if (n->consecutive_errors < UINT8_MAX) {
+            n->consecutive_errors++;
+        }
+        n->backoff = n->backoff ? MIN(n->backoff * 2, SPLIT_I2C_BACKOFF_MAX) : 1;
+        if (n->consecutive_errors > ERROR_DISCONNECT_COUNT) {
+            // release the keys of a disconnected node
+            memset(&matrix[n->row_offset], 0, n->row_count * sizeof(matrix_row_t));
+        }
+    }
+    n->last_attempt = timer_read();
+}
+
+// Sends whatever changed for this node and reads its rows straight into
+// their place in the master matrix.
+static bool node_poll(uint8_t node, matrix_row_t matrix[]) {
+    split_node_t *    n = &nodes[node];
+    I2C_node_buffer_t tx;
+    uint8_t           start = I2C_KEYMAP_START;
+
+#ifdef BACKLIGHT_ENABLE
+    tx.backlight_level = is_backlight_enabled() ? get_backlight_level() : 0;
+#else
+    tx.backlight_level = n->backlight_level;
+#endif
+#ifdef WPM_ENABLE
+    tx.current_wpm = get_current_wpm();
+    if (tx.current_wpm != n->current_wpm) {
+        start = I2C_WPM_START;
+    }
+#endif
+    if (tx.backlight_level != n->backlight_level) {
+        start = I2C_BACKLIGHT_START;
+    }
+#if defined(RGBLIGHT_ENABLE) && defined(RGBLIGHT_SPLIT)
+    if (rgblight_pending & (1 << node)) {
+        tx.rgblight_sync = rgblight_sync;
+        start            = I2C_RGB_START;
+    }
+#endif
+
+    uint8_t rx[node_matrix_size(SPLIT_NODE_MAX_ROWS)];
+    uint8_t rx_size = node_matrix_size(n->row_count);
+#ifdef SPLIT_LINK_STATS_ENABLE
+    uint16_t started = timer_read();
+#endif
+    // A NACK is retried right away, a timeout is not as it already stalled the scan
+    i2c_status_t status;
+    uint8_t      attempt = 0;
+    while ((status = i2c_writeReadReg(node_addresses[node], start, (uint8_t *)&tx + start, I2C_KEYMAP_START - start, rx, rx_size, SPLIT_I2C_TIMEOUT)) == I2C_STATUS_ERROR && attempt < SPLIT_I2C_RETRIES) {
+        attempt++;
+    }
+    if (status != I2C_STATUS_SUCCESS) {
+#ifdef SPLIT_LINK_STATS_ENABLE
+        split_stats_record(false, attempt, 0, started, timer_read());
+#endif
+        return false;
+    }
+#ifdef SPLIT_LINK_STATS_ENABLE
+    split_stats_record(true, attempt, 1 + (I2C_KEYMAP_START - start) + rx_size, started, timer_read());
+#endif
+    transport_unpack_matrix(&matrix[n->row_offset], rx, n->row_count);
+    n->backlight_level = tx.backlight_level;
+#ifdef WPM_ENABLE
+    n->current_wpm = tx.current_wpm;
+#endif
+#if defined(RGBLIGHT_ENABLE) && defined(RGBLIGHT_SPLIT)
+    rgblight_pending &= ~(1 << node);
+#endif
+    return true;
+}
+
+bool transport_master(matrix_row_t matrix[]) {
+    uint8_t self = split_node_index();
+    bool    ok   = true;
+
+#if defined(RGBLIGHT_ENABLE) && defined(RGBLIGHT_SPLIT)
+    if (rgblight_get_change_flags()) {
+        uint8_t pending_flags = rgblight_pending ? rgblight_sync.status.change_flags : 0;
+        rgblight_get_syncinfo(&rgblight_sync);
+        rgblight_sync.status.change_flags |= pending_flags;
+        rgblight_clear_change_flags();
+        rgblight_pending = ((1 << NUMBER_OF_NODES) - 1) & ~(1 << self);
+    }
+#endif
+
+    for (uint8_t i = 0; i < NUMBER_OF_NODES; i++) {
+        if (nodes[i].rounds_since_poll < UINT8_MAX) {
+            nodes[i].rounds_since_poll++;
+        }
+    }
+
+    // Round robin from where the previous scan stopped, so a poll limit
+    // below the node count still serves every node in turn
+    uint8_t polled = 0;
+    for (uint8_t i = 0; i < NUMBER_OF_NODES && polled < SPLIT_NODE_POLLS_PER_SCAN; i++) {
+        uint8_t node = (next_node + i) % NUMBER_OF_NODES;
+        if (node == self || !node_due(node)) {
+            continue;
+        }
+
+        bool success = node_poll(node, matrix);
+        node_update_health(node, success, matrix);
+        nodes[node].rounds_since_poll = 0;
+        ok &= success;
+        polled++;
+        next_node = (node + 1) % NUMBER_OF_NODES;
+    }
+
+    return ok;
+}
+
+void transport_slave(matrix_row_t matrix[]) {
+    transport_pack_matrix((uint8_t *)i2c_buffer->smatrix, matrix, nodes[split_node_index()].row_count);
+
+#ifdef BACKLIGHT_ENABLE
+    backlight_set(i2c_buffer->backlight_level);
+#endif
+
+#if defined(RGBLIGHT_ENABLE) && defined(RGBLIGHT_SPLIT)
+    if (i2c_buffer->rgblight_sync.status.change_flags != 0) {
+        rgblight_update_sync(&i2c_buffer->rgblight_sync, false);
+        i2c_buffer->rgblight_sync.status.change_flags = 0;
+    }
+#endif
+
+#ifdef WPM_ENABLE
+    set_current_wpm(i2c_buffer->current_wpm);
+#endif
+}
+
+void transport_master_init(void) {
+    nodes_init();
+    i2c_init();
+}
+
+void transport_slave_init(void) {
+    nodes_init();
+    i2c_slave_init(node_addresses[split_node_index()]);
+}
@@ -47,6 +47,10 @@
 #include "tmk_core/common/eeprom.h"
 #include "version.h"  // for QMK_BUILDDATE used in EEPROM magic
 
+#ifdef SPLIT_LINK_STATS_ENABLE
+#    include "split_stats.h"
+#endif
+
 // Forward declare some helpers.
 #if defined(VIA_QMK_BACKLIGHT_ENABLE)
 void via_qmk_backlight_set_value(uint8_t *data);
@@ -245,6 +249,24 @@ void raw_hid_receive(uint8_t *data, uint8_t length) {
 #endif
                     break;
                 }
+#ifdef SPLIT_LINK_STATS_ENABLE
+                case id_split_link_stats: {
+                    // command_data[1] is the offset into the serialized stats
+                    split_stats_pack(&command_data[2], command_data[1], length - 3);
+                    break;
+                }
+#endif
+#ifdef RGB_MATRIX_ENABLE
+                case id_rgb_matrix_effect: {
+                    // command_data[1] is the effect mode
+                    uint16_t interval = rgb_matrix_get_effect_interval(command_data[1]);
+                    command_data[2]   = RGB_MATRIX_EFFECT_MAX;
+                    command_data[3]   = rgb_matrix_get_effect_flags(command_data[1]);
+                    command_data[4]   = interval >> 8;
+                    command_data[5]   = interval & 0xFF;
+                    break;
+                }
+#endif
                 default: {
                     raw_hid_receive_kb(data, length);
                     break;
@@ -259,6 +281,12 @@ void raw_hid_receive(uint8_t *data, uint8_t length) {
                     via_set_layout_options(value);
                     break;
                 }
+#ifdef SPLIT_LINK_STATS_ENABLE
+                case id_split_link_stats: {
+                    split_stats_reset();
+                    break;
+                }
+#endif
                 default: {
                     raw_hid_receive_kb(data, length);
                     break;
@@ -76,7 +76,9 @@ enum via_command_id {
 enum via_keyboard_value_id {
     id_uptime              = 0x01,  //
     id_layout_options      = 0x02,
-    id_switch_matrix_state = 0x03
+    id_switch_matrix_state = 0x03,
+    id_split_link_stats    = 0x04,
+    id_rgb_matrix_effect   = 0x05
 };
 
 enum via_lighting_value {
@@ -47,6 +47,10 @@
 extern keymap_config_t keymap_config;
 #endif
 
+#if defined(RAW_ENABLE) && defined(SPLIT_LINK_STATS_ENABLE)
+#    include "split_stats.h"
+#endif
+
 /* ---------------------------------------------------------
  *       Global interface variables and declarations
  * ---------------------------------------------------------
@@ -814,6 +818,9 @@ __attribute__((weak)) void raw_hid_receive(uint8_t *data, uint8_t length) {
     // Users should #include "raw_hid.h" in their own code
     // and implement this function there. Leave this as weak linkage
     // so users can opt to not handle data coming in.
+#ifdef SPLIT_LINK_STATS_ENABLE
+    split_stats_raw_hid_receive(data, length);
+#endif
 }
 
 void raw_hid_task(void) {
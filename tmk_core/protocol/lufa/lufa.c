@@ -83,6 +83,9 @@ extern keymap_config_t keymap_config;
 
 #ifdef RAW_ENABLE
 #    include "raw_hid.h"
+#    ifdef SPLIT_LINK_STATS_ENABLE
+#        include "split_stats.h"
+#    endif
 #endif
 
 uint8_t keyboard_idle = 0;
@@ -170,6 +173,9 @@ __attribute__((weak)) void raw_hid_receive(uint8_t *data, uint8_t length) {
     // Users should #include "raw_hid.h" in their own code
     // and implement this function there. Leave this as weak linkage
     // so users can opt to not handle data coming in.
+#ifdef SPLIT_LINK_STATS_ENABLE
+    split_stats_raw_hid_receive(data, length);
+#endif
 }
 
 /** \brief Raw HID Task
@@ -30,6 +30,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #if defined(RAW_ENABLE)
 #    include "raw_hid.h"
+#    ifdef SPLIT_LINK_STATS_ENABLE
+#        include "split_stats.h"
+#    endif
 #endif
 
 #if (defined(MOUSE_ENABLE) || defined(EXTRAKEY_ENABLE)) && defined(RAW_ENABLE)
@@ -112,6 +115,9 @@ __attribute__((weak)) void raw_hid_receive(uint8_t *data, uint8_t length) {
     // Users should #include "raw_hid.h" in their own code
     // and implement this function there. Leave this as weak linkage
     // so users can opt to not handle data coming in.
+#ifdef SPLIT_LINK_STATS_ENABLE
+    split_stats_raw_hid_receive(data, length);
+#endif
 }
 
 void raw_hid_task(void) {